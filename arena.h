@@ -0,0 +1,201 @@
+#ifndef JWUTIL_ARENA_H
+#define JWUTIL_ARENA_H
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "blocksource.h"
+
+namespace jw_util
+{
+
+// Monotonic bump allocator. Memory is only given back all at once, by reset() or by rewinding to a marker, which makes both O(1) in the number of allocations.
+// Nothing allocated from it is ever destroyed, so create() is only useful for types whose destructors don't matter.
+// Chunks are kept when rewound past, so a reset arena allocates from the same memory again instead of going back to BlockSource.
+// Not thread-safe.
+
+template <typename BlockSource = BlockSourceHeap>
+class Arena
+{
+public:
+    struct Marker
+    {
+        std::size_t chunk_index;
+        std::size_t offset;
+    };
+
+    // Rewinds the arena to where it was when the scope was created
+    class Scope
+    {
+    public:
+        Scope(Arena &arena)
+            : arena(arena)
+            , marker(arena.get_marker())
+        {}
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope()
+        {
+            arena.rewind(marker);
+        }
+
+    private:
+        Arena &arena;
+        Marker marker;
+    };
+
+    Arena(std::size_t initial_chunk_bytes = 65536)
+        : next_chunk_bytes(initial_chunk_bytes)
+    {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena()
+    {
+        for (const Chunk &chunk : chunks)
+        {
+            BlockSource::free_block(chunk.data, chunk.size, chunk_alignment);
+        }
+    }
+
+    void *alloc(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+    {
+        assert(alignment && (alignment & (alignment - 1)) == 0);
+
+        while (cur_chunk < chunks.size())
+        {
+            Chunk &chunk = chunks[cur_chunk];
+            std::uintptr_t base = reinterpret_cast<std::uintptr_t>(chunk.data);
+            std::size_t start = ((base + cur_offset + alignment - 1) & ~(alignment - 1)) - base;
+            if (start + bytes <= chunk.size)
+            {
+                cur_offset = start + bytes;
+                return chunk.data + start;
+            }
+
+            // Later chunks are only there from before a rewind, and are tried in order before making a new one
+            cur_chunk++;
+            cur_offset = 0;
+        }
+
+        std::size_t chunk_bytes = next_chunk_bytes;
+        while (chunk_bytes < bytes + alignment)
+        {
+            chunk_bytes *= 2;
+        }
+        next_chunk_bytes = chunk_bytes * 2;
+
+        Chunk chunk;
+        chunk.data = static_cast<char *>(BlockSource::alloc_block(chunk_bytes, chunk_alignment));
+        chunk.size = chunk_bytes;
+        chunks.push_back(chunk);
+
+        return alloc(bytes, alignment);
+    }
+
+    template <typename Type, typename... ArgTypes>
+    Type *create(ArgTypes &&... args)
+    {
+        return new (alloc(sizeof(Type), alignof(Type))) Type(std::forward<ArgTypes>(args)...);
+    }
+
+    template <typename Type>
+    Type *alloc_array(std::size_t count)
+    {
+        return static_cast<Type *>(alloc(sizeof(Type) * count, alignof(Type)));
+    }
+
+    Marker get_marker() const
+    {
+        Marker marker;
+        marker.chunk_index = cur_chunk;
+        marker.offset = cur_offset;
+        return marker;
+    }
+
+    // Frees everything allocated since the marker was taken. Markers must be rewound to in LIFO order.
+    void rewind(Marker marker)
+    {
+        assert(marker.chunk_index < cur_chunk || (marker.chunk_index == cur_chunk && marker.offset <= cur_offset));
+
+        cur_chunk = marker.chunk_index;
+        cur_offset = marker.offset;
+    }
+
+    void reset()
+    {
+        cur_chunk = 0;
+        cur_offset = 0;
+    }
+
+    // Total bytes of chunks held, used or not
+    std::size_t get_capacity() const
+    {
+        std::size_t res = 0;
+        for (const Chunk &chunk : chunks)
+        {
+            res += chunk.size;
+        }
+        return res;
+    }
+
+private:
+    static constexpr std::size_t chunk_alignment = alignof(std::max_align_t);
+
+    struct Chunk
+    {
+        char *data;
+        std::size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    std::size_t cur_chunk = 0;
+    std::size_t cur_offset = 0;
+    std::size_t next_chunk_bytes;
+};
+
+// Lets std::pmr containers allocate from an Arena. Deallocation does nothing; the memory comes back when the arena is reset or rewound.
+// The arena has to outlive every container using it.
+
+template <typename BlockSource = BlockSourceHeap>
+class ArenaResource : public std::pmr::memory_resource
+{
+public:
+    ArenaResource(Arena<BlockSource> &arena)
+        : arena(arena)
+    {}
+
+    Arena<BlockSource> &get_arena() {return arena;}
+
+private:
+    Arena<BlockSource> &arena;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        return arena.alloc(bytes, alignment);
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override
+    {
+        (void) ptr;
+        (void) bytes;
+        (void) alignment;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+}
+
+#endif // JWUTIL_ARENA_H
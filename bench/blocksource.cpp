@@ -0,0 +1,92 @@
+// Compares the block sources, by filling pools with millions of live objects and then touching them in random order, which is where TLB misses show up.
+// Build: g++ -std=c++17 -O2 -I.. blocksource.cpp -o blocksource
+// Huge pages only get used if the system has them reserved (vm.nr_hugepages) or transparent huge pages enabled.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "blocksource.h"
+#include "poolchunked.h"
+#include "poolfifo.h"
+
+namespace
+{
+
+static constexpr unsigned int num_objects = 4000000;
+static constexpr unsigned int num_touches = 20000000;
+
+struct Object
+{
+    std::uint64_t value;
+    std::uint64_t padding[3];
+};
+
+// Keeps the touch loop from being optimized out
+volatile std::uint64_t sink;
+
+struct Result
+{
+    double alloc_ns;
+    double touch_ns;
+};
+
+template <typename PoolType>
+Result measure()
+{
+    Result res;
+    PoolType pool;
+    std::vector<Object *> objects(num_objects);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < num_objects; i++)
+    {
+        objects[i] = pool.alloc();
+        objects[i]->value = i;
+    }
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    res.alloc_ns = std::chrono::duration<double>(finish - start).count() * 1e9 / num_objects;
+
+    std::uint64_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < num_touches; i++)
+    {
+        // Each touch depends on the last, so they can't overlap
+        Object *object = objects[(i * 2654435761u + sum) % num_objects];
+        sum += object->value & 1;
+        object->value++;
+    }
+    finish = std::chrono::steady_clock::now();
+    res.touch_ns = std::chrono::duration<double>(finish - start).count() * 1e9 / num_touches;
+    sink = sum;
+
+    // In allocation order, which is what PoolFIFO needs
+    for (unsigned int i = 0; i < num_objects; i++)
+    {
+        pool.free(objects[i]);
+    }
+
+    return res;
+}
+
+template <typename BlockSource>
+void run_all(const char *name)
+{
+    Result chunked = measure<jw_util::PoolChunked<Object, 16384, BlockSource>>();
+    std::printf("%-26s PoolChunked  alloc: %6.1f ns  random touch: %6.1f ns\n", name, chunked.alloc_ns, chunked.touch_ns);
+
+    Result fifo = measure<jw_util::PoolFIFO<Object, BlockSource>>();
+    std::printf("%-26s PoolFIFO     alloc: %6.1f ns  random touch: %6.1f ns\n", name, fifo.alloc_ns, fifo.touch_ns);
+}
+
+}
+
+int main()
+{
+    run_all<jw_util::BlockSourceHeap>("BlockSourceHeap");
+    run_all<jw_util::BlockSourceMmap<false>>("BlockSourceMmap");
+    run_all<jw_util::BlockSourceMmap<true>>("BlockSourceMmap<prefault>");
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+// Compares SlabAllocator against operator new/delete, Pool and PoolFIFO, at 1 to 32 threads,
+// with every thread allocating and freeing its own objects, and with objects handed to another thread to be freed.
+// Pool isn't thread-safe, so it only runs the first pattern. PoolFIFO only allows one thread on each side,
+// which the second pattern satisfies, since every thread's objects are freed by a single partner.
+// Build: g++ -std=c++17 -O2 -I.. slaballocator.cpp -o slaballocator -pthread
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "slaballocator.h"
+#include "pool.h"
+#include "poolfifo.h"
+
+namespace
+{
+
+static constexpr unsigned int num_ops = 2000000;
+static constexpr unsigned int live_count = 1024;
+static constexpr unsigned int max_threads = 32;
+
+// Sources are told which thread allocated each object, so the typed pools below can keep one pool per thread
+
+struct SlabSource
+{
+    static void *alloc(unsigned int owner, std::size_t size) {(void) owner; return jw_util::SlabAllocator::alloc(size);}
+    static void free(unsigned int owner, void *ptr, std::size_t size) {(void) owner; jw_util::SlabAllocator::free(ptr, size);}
+};
+
+struct NewSource
+{
+    static void *alloc(unsigned int owner, std::size_t size) {(void) owner; return ::operator new(size);}
+    static void free(unsigned int owner, void *ptr, std::size_t size) {(void) owner; (void) size; ::operator delete(ptr);}
+};
+
+template <std::size_t size>
+struct alignas(16) Object
+{
+    char data[size];
+};
+
+template <typename Type>
+using PoolDefault = jw_util::Pool<Type>;
+
+template <typename Type>
+using PoolFIFODefault = jw_util::PoolFIFO<Type>;
+
+// Keeps a pool for every allocating thread, for each of the sizes get_size returns
+template <template <typename> class PoolType>
+struct TypedPoolSource
+{
+    static void *alloc(unsigned int owner, std::size_t size)
+    {
+        return alloc_sized<16, 24, 32, 48, 64, 96, 128, 256, 512>(owner, size);
+    }
+
+    static void free(unsigned int owner, void *ptr, std::size_t size)
+    {
+        free_sized<16, 24, 32, 48, 64, 96, 128, 256, 512>(owner, ptr, size);
+    }
+
+    template <std::size_t size>
+    static PoolType<Object<size>> &get_pool(unsigned int owner)
+    {
+        static PoolType<Object<size>> pools[max_threads];
+        return pools[owner];
+    }
+
+    template <std::size_t... sizes>
+    static void *alloc_sized(unsigned int owner, std::size_t size)
+    {
+        void *res = 0;
+        (void) ((size == sizes && (res = get_pool<sizes>(owner).alloc())) || ...);
+        return res;
+    }
+
+    template <std::size_t... sizes>
+    static void free_sized(unsigned int owner, void *ptr, std::size_t size)
+    {
+        (void) ((size == sizes && (get_pool<sizes>(owner).free(static_cast<Object<sizes> *>(ptr)), true)) || ...);
+    }
+};
+
+typedef TypedPoolSource<PoolDefault> PoolSource;
+typedef TypedPoolSource<PoolFIFODefault> PoolFIFOSource;
+
+static std::size_t get_size(unsigned int i)
+{
+    // Mostly small, like typical nodes, with the odd bigger one
+    static constexpr std::size_t sizes[] = {16, 24, 32, 48, 64, 16, 96, 128, 32, 256, 16, 512};
+    return sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+}
+
+// Each thread keeps a window of live objects, and replaces the oldest one every step
+template <typename Source>
+void run_local(unsigned int thread_index)
+{
+    std::vector<void *> live(live_count, 0);
+    for (unsigned int i = 0; i < num_ops; i++)
+    {
+        unsigned int slot = i % live_count;
+        if (live[slot])
+        {
+            Source::free(thread_index, live[slot], get_size(i - live_count + thread_index));
+        }
+        live[slot] = Source::alloc(thread_index, get_size(i + thread_index));
+        static_cast<char *>(live[slot])[0] = static_cast<char>(i);
+    }
+
+    for (unsigned int i = num_ops; i < num_ops + live_count; i++)
+    {
+        unsigned int slot = i % live_count;
+        if (live[slot])
+        {
+            Source::free(thread_index, live[slot], get_size(i - live_count + thread_index));
+        }
+    }
+}
+
+// Threads are paired up, and each one frees what its partner allocated
+template <typename Source>
+void run_cross(std::vector<std::vector<void *>> &handoff, unsigned int thread_index, unsigned int num_threads)
+{
+    unsigned int partner = thread_index ^ 1;
+    if (partner >= num_threads) {partner = thread_index;}
+
+    unsigned int rounds = num_ops / live_count;
+    for (unsigned int round = 0; round < rounds; round++)
+    {
+        std::vector<void *> &mine = handoff[thread_index * rounds + round];
+        for (unsigned int i = 0; i < live_count; i++)
+        {
+            __atomic_store_n(&mine[i], Source::alloc(thread_index, get_size(i)), __ATOMIC_RELEASE);
+        }
+
+        // Free the partner's previous round, spinning on any pointer it hasn't published yet
+        if (round)
+        {
+            std::vector<void *> &theirs = handoff[partner * rounds + round - 1];
+            for (unsigned int i = 0; i < live_count; i++)
+            {
+                void *ptr;
+                while (!(ptr = __atomic_load_n(&theirs[i], __ATOMIC_ACQUIRE)))
+                {
+                    std::this_thread::yield();
+                }
+                Source::free(partner, ptr, get_size(i));
+            }
+        }
+    }
+}
+
+template <typename Source>
+double measure_local(unsigned int num_threads)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        threads.emplace_back(run_local<Source>, i);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(finish - start).count() * 1e9 / (static_cast<double>(num_ops) * num_threads);
+}
+
+template <typename Source>
+double measure_cross(unsigned int num_threads)
+{
+    unsigned int rounds = num_ops / live_count;
+    std::vector<std::vector<void *>> handoff(num_threads * rounds, std::vector<void *>(live_count, 0));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        threads.emplace_back(run_cross<Source>, std::ref(handoff), i, num_threads);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+
+    // The last round of each thread is never freed by its partner
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        std::vector<void *> &last = handoff[i * rounds + rounds - 1];
+        for (unsigned int j = 0; j < live_count; j++)
+        {
+            Source::free(i, last[j], get_size(j));
+        }
+    }
+
+    return std::chrono::duration<double>(finish - start).count() * 1e9 / (static_cast<double>(rounds) * live_count * num_threads);
+}
+
+}
+
+int main()
+{
+    // All times are ns per alloc/free pair
+    std::printf("%7s  %-39s  %-29s\n", "", "local", "cross");
+    std::printf("%7s  %9s %9s %9s %9s  %9s %9s %9s\n", "threads", "slab", "new", "pool", "poolfifo", "slab", "new", "poolfifo");
+
+    for (unsigned int num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        std::printf("%7u  %9.1f %9.1f %9.1f %9.1f  %9.1f %9.1f %9.1f\n",
+            num_threads,
+            measure_local<SlabSource>(num_threads),
+            measure_local<NewSource>(num_threads),
+            measure_local<PoolSource>(num_threads),
+            measure_local<PoolFIFOSource>(num_threads),
+            measure_cross<SlabSource>(num_threads),
+            measure_cross<NewSource>(num_threads),
+            measure_cross<PoolFIFOSource>(num_threads));
+    }
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Counts how often starting a coroutine on WorkQueueCoroutine goes to the global operator new, once it's warm,
+// with frames from WorkQueueFrameAllocator and with plain heap frames.
+// Each coroutine is started on the main thread and finishes on a worker, so its frame is freed on a different thread than it was allocated on.
+// The queue's own std::deque still allocates a node every few dozen pushes, so the frame allocator should bring it down to about that.
+// Build: g++ -std=c++20 -O2 -I.. workqueuecoroutine.cpp -o workqueuecoroutine -pthread
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <thread>
+
+#include "workqueuecoroutine.h"
+
+namespace
+{
+
+std::atomic<unsigned long long> global_news {0};
+
+}
+
+void *operator new(std::size_t size)
+{
+    global_news.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size) noexcept
+{
+    (void) size;
+    std::free(ptr);
+}
+
+namespace
+{
+
+static constexpr unsigned int num_threads = 4;
+static constexpr unsigned int num_coroutines = 10000;
+
+typedef jw_util::WorkQueueCoroutine<num_threads> QueueType;
+
+// Same as WorkQueueTask, but its frames come straight from the heap
+class HeapTask
+{
+public:
+    struct promise_type
+    {
+        HeapTask get_return_object() {return HeapTask();}
+        std::suspend_never initial_suspend() noexcept {return {};}
+        std::suspend_never final_suspend() noexcept {return {};}
+        void return_void() {}
+        void unhandled_exception() {std::terminate();}
+    };
+};
+
+std::atomic<unsigned int> remaining {0};
+std::atomic<unsigned long long> sink {0};
+
+template <typename TaskType>
+TaskType run_one(QueueType &queue, unsigned int value)
+{
+    co_await queue.schedule();
+
+    unsigned long long x = value;
+    for (unsigned int i = 0; i < 16; i++)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    sink.fetch_add(x & 1, std::memory_order_relaxed);
+
+    remaining.fetch_sub(1, std::memory_order_release);
+}
+
+template <typename TaskType>
+void run_batch(QueueType &queue)
+{
+    remaining.store(num_coroutines, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < num_coroutines; i++)
+    {
+        run_one<TaskType>(queue, i);
+    }
+    while (remaining.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+template <typename TaskType>
+void measure(QueueType &queue, const char *name)
+{
+    // The first batch warms up the frame allocator and the queue
+    run_batch<TaskType>(queue);
+
+    unsigned long long news_before = global_news.load(std::memory_order_relaxed);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    run_batch<TaskType>(queue);
+
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    unsigned long long news = global_news.load(std::memory_order_relaxed) - news_before;
+
+    std::printf("%-16s %8llu global news for %u warm coroutines    %6.1f ns/coroutine\n",
+        name, news, num_coroutines, std::chrono::duration<double>(finish - start).count() * 1e9 / num_coroutines);
+}
+
+}
+
+int main()
+{
+    QueueType queue;
+    measure<jw_util::WorkQueueTask>(queue, "WorkQueueTask");
+    measure<HeapTask>(queue, "heap frames");
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Compares WorkQueueStealing against the shared-queue WorkQueue, at 1 to 64 worker threads.
+// Build: g++ -std=c++17 -O2 -I.. workqueuestealing.cpp -o workqueuestealing -pthread
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "workqueue.h"
+#include "workqueuestealing.h"
+
+namespace
+{
+
+// Each task does a little work, then pushes its children from the worker thread, like a recursive divide-and-conquer
+template <typename QueueType>
+class TreeBench
+{
+public:
+    TreeBench(unsigned int depth, unsigned int fanout)
+        : depth(depth)
+        , fanout(fanout)
+        , queue(jw_util::MethodCallback<unsigned int>::create<TreeBench, &TreeBench::run>(this))
+    {}
+
+    double measure()
+    {
+        std::uint64_t total = 0;
+        std::uint64_t level = 1;
+        for (unsigned int i = 0; i <= depth; i++)
+        {
+            total += level;
+            level *= fanout;
+        }
+        remaining.store(total, std::memory_order_relaxed);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        queue.push(0);
+        while (remaining.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(finish - start).count() * 1e9 / total;
+    }
+
+private:
+    unsigned int depth;
+    unsigned int fanout;
+    std::atomic<std::uint64_t> remaining {0};
+    std::atomic<std::uint64_t> sink {0};
+    QueueType queue;
+
+    void run(unsigned int level)
+    {
+        std::uint64_t x = level;
+        for (unsigned int i = 0; i < 200; i++)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        sink.fetch_add(x & 1, std::memory_order_relaxed);
+
+        if (level < depth)
+        {
+            for (unsigned int i = 0; i < fanout; i++)
+            {
+                queue.push(level + 1);
+            }
+        }
+
+        remaining.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+// Every task is pushed from the main thread
+template <typename QueueType>
+class FlatBench
+{
+public:
+    FlatBench()
+        : queue(jw_util::MethodCallback<unsigned int>::create<FlatBench, &FlatBench::run>(this))
+    {}
+
+    double measure(unsigned int count)
+    {
+        remaining.store(count, std::memory_order_relaxed);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            queue.push(i);
+        }
+        while (remaining.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(finish - start).count() * 1e9 / count;
+    }
+
+private:
+    std::atomic<std::uint64_t> remaining {0};
+    std::atomic<std::uint64_t> sink {0};
+    QueueType queue;
+
+    void run(unsigned int value)
+    {
+        sink.fetch_add(value & 1, std::memory_order_relaxed);
+        remaining.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+struct Result
+{
+    double tree_ns;
+    double flat_ns;
+};
+
+template <typename QueueType>
+Result run_queue()
+{
+    Result res;
+
+    TreeBench<QueueType> tree(7, 8);
+    res.tree_ns = tree.measure();
+
+    FlatBench<QueueType> flat;
+    res.flat_ns = flat.measure(2000000);
+
+    return res;
+}
+
+template <unsigned int num_threads>
+void run_row()
+{
+    Result shared = run_queue<jw_util::WorkQueue<num_threads, unsigned int>>();
+    Result stealing = run_queue<jw_util::WorkQueueStealing<num_threads, unsigned int>>();
+
+    std::printf("%7u  %12.1f %12.1f  %12.1f %12.1f\n", num_threads, shared.tree_ns, shared.flat_ns, stealing.tree_ns, stealing.flat_ns);
+}
+
+}
+
+int main()
+{
+    // All times are ns/task
+    std::printf("%7s  %25s  %25s\n", "", "WorkQueue", "WorkQueueStealing");
+    std::printf("%7s  %12s %12s  %12s %12s\n", "threads", "tree", "flat", "tree", "flat");
+
+    run_row<1>();
+    run_row<2>();
+    run_row<4>();
+    run_row<8>();
+    run_row<16>();
+    run_row<32>();
+    run_row<64>();
+    return 0;
+}
@@ -0,0 +1,199 @@
+#ifndef JWUTIL_BLOCKSOURCE_H
+#define JWUTIL_BLOCKSOURCE_H
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace jw_util
+{
+
+// Where pools get their big blocks of memory from. A block source is a static class with:
+//     static void *alloc_block(std::size_t bytes, std::size_t alignment);
+//     static void free_block(void *ptr, std::size_t bytes, std::size_t alignment);
+// free_block gets the same bytes and alignment that alloc_block did. Blocks are uninitialized.
+
+class BlockSourceHeap
+{
+public:
+    BlockSourceHeap() = delete;
+
+    static void *alloc_block(std::size_t bytes, std::size_t alignment)
+    {
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    static void free_block(void *ptr, std::size_t bytes, std::size_t alignment)
+    {
+        (void) bytes;
+        ::operator delete(ptr, std::align_val_t(alignment));
+    }
+};
+
+// Carves blocks out of 2 MiB regions mapped straight from the OS, so that blocks allocated together share huge pages and take fewer TLB entries.
+// Regions are mapped with MAP_HUGETLB if the system has huge pages reserved, otherwise they're 2 MiB-aligned normal mappings with madvise(MADV_HUGEPAGE),
+// which gets transparent huge pages when they're enabled. With prefault, regions are faulted in when mapped instead of on first touch.
+// Freed blocks are kept for reuse by blocks of the same size and alignment; regions are never unmapped. Blocks bigger than a region get their own mapping.
+// On platforms other than Linux, this is just BlockSourceHeap.
+
+template <bool prefault = false>
+class BlockSourceMmap
+{
+public:
+    BlockSourceMmap() = delete;
+
+    static constexpr std::size_t region_bytes = static_cast<std::size_t>(2) << 20;
+
+    static void *alloc_block(std::size_t bytes, std::size_t alignment)
+    {
+#ifdef __linux__
+        assert(alignment && (alignment & (alignment - 1)) == 0);
+
+        if (bytes > region_bytes || alignment > region_bytes)
+        {
+            return map_region((bytes + region_bytes - 1) & ~(region_bytes - 1), alignment > region_bytes ? alignment : region_bytes);
+        }
+
+        State &state = get_state();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        (void) lock;
+
+        for (std::size_t i = state.freed.size(); i-- > 0;)
+        {
+            if (state.freed[i].bytes == bytes && state.freed[i].alignment == alignment)
+            {
+                void *res = state.freed[i].ptr;
+                state.freed[i] = state.freed.back();
+                state.freed.pop_back();
+                return res;
+            }
+        }
+
+        std::uintptr_t start = (reinterpret_cast<std::uintptr_t>(state.region_cur) + alignment - 1) & ~(alignment - 1);
+        if (!state.region_cur || start + bytes > reinterpret_cast<std::uintptr_t>(state.region_end))
+        {
+            // Whatever's left of the old region is abandoned
+            state.region_cur = static_cast<char *>(map_region(region_bytes, region_bytes));
+            state.region_end = state.region_cur + region_bytes;
+            start = reinterpret_cast<std::uintptr_t>(state.region_cur);
+        }
+
+        state.region_cur = reinterpret_cast<char *>(start + bytes);
+        return reinterpret_cast<void *>(start);
+#else
+        return BlockSourceHeap::alloc_block(bytes, alignment);
+#endif
+    }
+
+    static void free_block(void *ptr, std::size_t bytes, std::size_t alignment)
+    {
+#ifdef __linux__
+        if (bytes > region_bytes || alignment > region_bytes)
+        {
+            munmap(ptr, (bytes + region_bytes - 1) & ~(region_bytes - 1));
+            return;
+        }
+
+        State &state = get_state();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        (void) lock;
+
+        FreedBlock freed;
+        freed.ptr = ptr;
+        freed.bytes = bytes;
+        freed.alignment = alignment;
+        state.freed.push_back(freed);
+#else
+        BlockSourceHeap::free_block(ptr, bytes, alignment);
+#endif
+    }
+
+private:
+#ifdef __linux__
+    struct FreedBlock
+    {
+        void *ptr;
+        std::size_t bytes;
+        std::size_t alignment;
+    };
+
+    struct State
+    {
+        std::mutex mutex;
+        char *region_cur = 0;
+        char *region_end = 0;
+        std::vector<FreedBlock> freed;
+    };
+
+    static State &get_state()
+    {
+        static State state;
+        return state;
+    }
+
+    // Maps bytes (a multiple of region_bytes) aligned to alignment (at least region_bytes)
+    static void *map_region(std::size_t bytes, std::size_t alignment)
+    {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        if (prefault)
+        {
+            flags |= MAP_POPULATE;
+        }
+
+#ifdef MAP_HUGETLB
+        // Huge page mappings are always aligned to the huge page size, so this only works if that's all the alignment we need
+        if (alignment == region_bytes)
+        {
+            void *res = mmap(0, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            if (res != MAP_FAILED)
+            {
+                return res;
+            }
+        }
+#endif
+
+        // Map enough extra to find an aligned range in it, then trim both ends. This one isn't populated yet, so the madvise can apply first.
+        std::size_t map_bytes = bytes + alignment;
+        char *map = static_cast<char *>(mmap(0, map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (map == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        char *res = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(map) + alignment - 1) & ~(alignment - 1));
+        if (res != map)
+        {
+            munmap(map, res - map);
+        }
+        if (res + bytes != map + map_bytes)
+        {
+            munmap(res + bytes, map + map_bytes - (res + bytes));
+        }
+
+#ifdef MADV_HUGEPAGE
+        madvise(res, bytes, MADV_HUGEPAGE);
+#endif
+
+        if (prefault)
+        {
+            for (std::size_t i = 0; i < bytes; i += 4096)
+            {
+                static_cast<volatile char *>(res)[i] = 0;
+            }
+        }
+
+        return res;
+    }
+#endif
+};
+
+}
+
+#endif // JWUTIL_BLOCKSOURCE_H
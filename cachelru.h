@@ -74,8 +74,8 @@ public:
 
     Result access(const KeyType &key)
     {
-        float next_load_factor = (map.size() + 2.0f) / map.bucket_count();
-        if (next_load_factor > map.max_load_factor())
+        // The map is made with at least num_buckets buckets, so staying at or under num_buckets elements means it never rehashes
+        if (map.size() >= num_buckets)
         {
             map.erase(forget_get_front()->val);
             forget_shift();
@@ -172,6 +172,7 @@ private:
 
         forget_available = forget_get_front();
         forget_connector.next = forget_connector.next->next;
+        forget_connector.next->prev = &forget_connector;
     }
 
     void forget_erase(ListNode *node)
@@ -0,0 +1,103 @@
+#ifndef JWUTIL_CACHELRUSHARDED_H
+#define JWUTIL_CACHELRUSHARDED_H
+
+#include <assert.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "cachelru.h"
+
+namespace jw_util
+{
+
+// A CacheLRU that can be shared between threads. Keys are hashed to one of num_shards independent caches, each with its own mutex,
+// so threads only contend when they hit the same shard. Each shard evicts on its own, holding up to num_buckets_per_shard entries.
+// Results can't be handed out, since they'd outlive the lock, so access takes a function to run on the value while the shard is locked.
+
+template <typename KeyType, typename ValueType, unsigned int num_buckets_per_shard, unsigned int num_shards = 16, typename Hasher = std::hash<KeyType>>
+class CacheLRUSharded
+{
+public:
+    typedef CacheLRU<KeyType, ValueType, num_buckets_per_shard, Hasher> ShardType;
+
+    struct ShardStats
+    {
+        unsigned long long hits;
+        unsigned long long misses;
+    };
+
+    CacheLRUSharded()
+        : shards(new Shard[num_shards])
+    {}
+
+    // Calls fn(ValueType &value, bool valid) with the shard locked, and returns what it returns.
+    // valid is false if the key wasn't cached, in which case value is default-constructed and fn should fill it in.
+    template <typename FunctionType>
+    decltype(auto) access(const KeyType &key, FunctionType &&fn)
+    {
+        Shard &shard = shards[get_shard_index(key)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        (void) lock;
+
+        typename ShardType::Result result = shard.cache.access(key);
+        std::atomic<unsigned long long> &counter = result.is_valid() ? shard.hits : shard.misses;
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        return fn(*result.get_value(), result.is_valid());
+    }
+
+    // Can be called at any time; the two counts are read separately, so they might be off by one from each other
+    ShardStats get_shard_stats(unsigned int shard_index) const
+    {
+        assert(shard_index < num_shards);
+
+        ShardStats res;
+        res.hits = shards[shard_index].hits.load(std::memory_order_relaxed);
+        res.misses = shards[shard_index].misses.load(std::memory_order_relaxed);
+        return res;
+    }
+
+    ShardStats get_total_stats() const
+    {
+        ShardStats res;
+        res.hits = 0;
+        res.misses = 0;
+        for (unsigned int i = 0; i < num_shards; i++)
+        {
+            ShardStats shard = get_shard_stats(i);
+            res.hits += shard.hits;
+            res.misses += shard.misses;
+        }
+        return res;
+    }
+
+    unsigned int get_shard_index(const KeyType &key) const
+    {
+        // The shard's map buckets by the same hash, so spread it first, otherwise each shard would only use some of its buckets
+        std::uint64_t hash = static_cast<std::uint64_t>(Hasher()(key)) * static_cast<std::uint64_t>(0x9e3779b97f4a7c15u);
+        return (hash >> 32) % num_shards;
+    }
+
+    static constexpr unsigned int get_num_shards() {return num_shards;}
+
+private:
+    static_assert(num_shards > 0, "CacheLRUSharded<KeyType, ValueType, num_buckets_per_shard, num_shards, Hasher>: Must have at least one shard");
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        ShardType cache;
+
+        // Only written with the mutex held, but atomic so stats can be read without it
+        std::atomic<unsigned long long> hits {0};
+        std::atomic<unsigned long long> misses {0};
+    };
+
+    std::unique_ptr<Shard[]> shards;
+};
+
+}
+
+#endif // JWUTIL_CACHELRUSHARDED_H
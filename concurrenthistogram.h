@@ -0,0 +1,117 @@
+#ifndef JWUTIL_CONCURRENTHISTOGRAM_H
+#define JWUTIL_CONCURRENTHISTOGRAM_H
+
+#include <assert.h>
+#include <atomic>
+#include <cstdint>
+
+namespace jw_util
+{
+
+// HDR-style histogram of unsigned 64-bit values that any number of threads can record into without locking.
+// Values below 2^sub_bits are counted exactly; above that, each power of 2 is split into 2^(sub_bits - 1) linear buckets,
+// so every bucket is within a relative error of 2^-(sub_bits - 1) of the values it holds.
+
+template <unsigned int sub_bits = 5>
+class ConcurrentHistogram
+{
+    static_assert(sub_bits >= 1 && sub_bits < 32, "ConcurrentHistogram<sub_bits>: sub_bits must be between 1 and 31");
+
+    static constexpr unsigned int half_count = 1u << (sub_bits - 1);
+    static constexpr unsigned int num_buckets = (66 - sub_bits) * half_count;
+
+public:
+    ConcurrentHistogram()
+    {
+        for (unsigned int i = 0; i < num_buckets; i++)
+        {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(std::uint64_t value)
+    {
+        buckets[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Not an atomic snapshot: values recorded concurrently may or may not be counted
+    std::uint64_t get_count() const
+    {
+        std::uint64_t count = 0;
+        for (unsigned int i = 0; i < num_buckets; i++)
+        {
+            count += buckets[i].load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    // Returns the highest value that's equivalent to the value at the given quantile (0.0 to 1.0), or 0 if nothing has been recorded
+    std::uint64_t get_quantile(double quantile) const
+    {
+        std::uint64_t counts[num_buckets];
+        std::uint64_t total = 0;
+        for (unsigned int i = 0; i < num_buckets; i++)
+        {
+            counts[i] = buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+
+        if (!total) {return 0;}
+
+        std::uint64_t target = static_cast<std::uint64_t>(quantile * total);
+        if (target >= total) {target = total - 1;}
+
+        std::uint64_t seen = 0;
+        for (unsigned int i = 0; i < num_buckets; i++)
+        {
+            seen += counts[i];
+            if (seen > target)
+            {
+                return get_bucket_max(i);
+            }
+        }
+
+        assert(false);
+        return 0;
+    }
+
+    void reset()
+    {
+        for (unsigned int i = 0; i < num_buckets; i++)
+        {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::atomic<std::uint64_t> buckets[num_buckets];
+
+    static unsigned int get_bucket(std::uint64_t value)
+    {
+        if (value < (static_cast<std::uint64_t>(1) << sub_bits))
+        {
+            return value;
+        }
+
+        unsigned int msb = 63 - __builtin_clzll(value);
+        unsigned int shift = msb - (sub_bits - 1);
+        unsigned int top = value >> shift;
+        return shift * half_count + top;
+    }
+
+    static std::uint64_t get_bucket_max(unsigned int bucket)
+    {
+        if (bucket < (1u << sub_bits))
+        {
+            return bucket;
+        }
+
+        unsigned int shift = bucket / half_count - 1;
+        std::uint64_t top = bucket - shift * half_count;
+        return (top << shift) + ((static_cast<std::uint64_t>(1) << shift) - 1);
+    }
+};
+
+}
+
+#endif // JWUTIL_CONCURRENTHISTOGRAM_H
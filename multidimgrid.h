@@ -91,6 +91,23 @@ public:
         return data[index];
     }
 
+    // Inverse of the index computed by operator[](Coord), for iterating over [0, get_limit()) by index
+    Coord get_coord(unsigned int index) const
+    {
+        assert(index < get_limit());
+
+        Coord coord;
+        unsigned int i = dims;
+        while (i--)
+        {
+            unsigned int width = max[i] - min[i];
+            coord[i] = min[i] + static_cast<signed int>(index % width);
+            index /= width;
+        }
+
+        return coord;
+    }
+
     void constrain_coord(Coord &coord) const
     {
         for (unsigned int i = 0; i < dims; i++)
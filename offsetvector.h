@@ -1,11 +1,19 @@
 #ifndef JWUTIL_OFFSETVECTOR_H
 #define JWUTIL_OFFSETVECTOR_H
 
-#include <deque>
+#include <assert.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
 
 namespace jw_util
 {
 
+// A vector indexed from get_offset() rather than 0, which grows in either direction to cover whatever index is accessed.
+// The elements are contiguous, from data() to data() + size(), so they can be scanned directly.
+// The buffer keeps spare room at both ends, and doubles when either end runs out, so growing either way is amortized O(1).
+// Growing invalidates pointers to the elements.
+
 template <typename Type>
 class OffsetVector
 {
@@ -13,34 +21,84 @@ public:
     OffsetVector()
     {}
 
-    Type &operator[](typename std::deque<Type>::size_type i)
+    Type &operator[](std::size_t i)
     {
-        if (items.empty())
+        if (count == 0)
         {
-            items.emplace_back();
+            relocate(0, 1);
             offset = i;
-            return items.front();
+            return buffer[head];
         }
 
         if (i < offset)
         {
-            items.insert(items.begin(), offset - i, Type());
+            std::size_t extra = offset - i;
+            if (head < extra)
+            {
+                relocate(extra, 0);
+            }
+            else
+            {
+                head -= extra;
+                count += extra;
+            }
             offset = i;
-            return items.front();
+            return buffer[head];
         }
 
         i -= offset;
-        if (i >= items.size())
+        if (i >= count)
         {
-            items.resize(i + 1);
+            std::size_t extra = i + 1 - count;
+            if (buffer.size() - head - count < extra)
+            {
+                relocate(0, extra);
+            }
+            else
+            {
+                count += extra;
+            }
         }
 
-        return items[i];
+        return buffer[head + i];
     }
 
+    Type *data() {return buffer.data() + head;}
+    const Type *data() const {return buffer.data() + head;}
+    std::size_t size() const {return count;}
+    bool empty() const {return count == 0;}
+
+    // The index of data()[0]. Meaningless while empty.
+    std::size_t get_offset() const {return offset;}
+
+    Type *begin() {return data();}
+    const Type *begin() const {return data();}
+    Type *end() {return data() + count;}
+    const Type *end() const {return data() + count;}
+
 protected:
-    typename std::deque<Type>::size_type offset;
-    std::deque<Type> items;
+    // Everything outside [head, head + count) is default-constructed and untouched, so growing into it needs no construction
+    std::vector<Type> buffer;
+    std::size_t head = 0;
+    std::size_t count = 0;
+    std::size_t offset = 0;
+
+    void relocate(std::size_t extra_front, std::size_t extra_back)
+    {
+        std::size_t new_count = count + extra_front + extra_back;
+        std::size_t new_capacity = new_count * 2 > 16 ? new_count * 2 : 16;
+        std::size_t new_head = (new_capacity - new_count) / 2;
+
+        std::vector<Type> new_buffer(new_capacity);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            new_buffer[new_head + extra_front + i] = std::move(buffer[head + i]);
+        }
+
+        buffer = std::move(new_buffer);
+        head = new_head;
+        count = new_count;
+    }
 };
 
 }
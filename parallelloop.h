@@ -0,0 +1,236 @@
+#ifndef JWUTIL_PARALLELLOOP_H
+#define JWUTIL_PARALLELLOOP_H
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <algorithm>
+
+#include "methodcallback.h"
+#include "workqueue.h"
+
+namespace jw_util
+{
+
+// Splits index ranges across its own WorkQueue workers plus the calling thread.
+// Participants claim chunks from a shared atomic index, starting big and shrinking as the range runs out (guided scheduling), so uneven work still balances without much contention.
+// The caller only waits for chunks that are already running elsewhere, so it's fine to call from inside another loop's function, or from any thread.
+// For a MultiDimGrid, loop over [0, grid.get_limit()) and use grid.get_coord() if the coordinates are needed.
+
+template <unsigned int num_threads>
+class ParallelLoop
+{
+public:
+    ParallelLoop()
+        : queue(jw_util::MethodCallback<Job *>::template create<ParallelLoop, &ParallelLoop::run_job>(this))
+    {}
+
+    // Calls fn(chunk_begin, chunk_end) for disjoint chunks covering [begin, end). Chunks are at least grain long, except maybe the last one.
+    template <typename FunctionType>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, FunctionType &&fn)
+    {
+        ForContext<FunctionType> context(fn);
+        run(begin, end, grain, &participate_for<FunctionType>, &context);
+    }
+
+    // Returns reduce(...reduce(identity, fn(chunk_begin, chunk_end))...) over disjoint chunks covering [begin, end).
+    // Chunks are combined in no particular order, so reduce has to be associative and commutative.
+    template <typename ValueType, typename FunctionType, typename ReduceType>
+    ValueType parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, ValueType identity, FunctionType &&fn, ReduceType &&reduce)
+    {
+        ReduceContext<ValueType, FunctionType, ReduceType> context(fn, reduce, std::move(identity));
+        run(begin, end, grain, &participate_reduce<ValueType, FunctionType, ReduceType>, &context);
+        return std::move(context.result);
+    }
+
+private:
+    // Lives on the heap, since workers can still be holding it after the caller has returned
+    struct Job
+    {
+        std::atomic<std::size_t> next;
+        std::size_t end;
+        std::size_t grain;
+        unsigned int num_participants;
+
+        std::size_t total;
+        std::atomic<std::size_t> done {0};
+
+        // Only dereferenced by a participant that has claimed a chunk, which means the caller is still waiting
+        void (*participate)(Job *job);
+        void *context;
+
+        std::atomic<unsigned int> refs;
+
+        std::mutex mutex;
+        std::condition_variable done_variable;
+    };
+
+    template <typename FunctionType>
+    struct ForContext
+    {
+        ForContext(FunctionType &init_fn)
+            : fn(init_fn)
+        {}
+
+        FunctionType &fn;
+    };
+
+    template <typename ValueType, typename FunctionType, typename ReduceType>
+    struct ReduceContext
+    {
+        ReduceContext(FunctionType &init_fn, ReduceType &init_reduce, ValueType &&init_result)
+            : fn(init_fn)
+            , reduce(init_reduce)
+            , result(std::move(init_result))
+        {}
+
+        FunctionType &fn;
+        ReduceType &reduce;
+        ValueType result;
+    };
+
+    // Declared last, so the workers are stopped before anything they use is destroyed
+    jw_util::WorkQueue<num_threads, Job *> queue;
+
+    void run(std::size_t begin, std::size_t end, std::size_t grain, void (*participate)(Job *job), void *context)
+    {
+        if (begin >= end) {return;}
+        if (!grain) {grain = 1;}
+
+        std::size_t num_chunks = (end - begin + grain - 1) / grain;
+        unsigned int num_helpers = std::min<std::size_t>(num_threads, num_chunks - 1);
+
+        Job *job = new Job();
+        job->next.store(begin, std::memory_order_relaxed);
+        job->end = end;
+        job->grain = grain;
+        job->num_participants = num_helpers + 1;
+        job->total = end - begin;
+        job->participate = participate;
+        job->context = context;
+        job->refs.store(num_helpers + 1, std::memory_order_relaxed);
+
+        for (unsigned int i = 0; i < num_helpers; i++)
+        {
+            queue.push(job);
+        }
+
+        participate(job);
+
+        if (job->done.load(std::memory_order_acquire) != job->total)
+        {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            while (job->done.load(std::memory_order_acquire) != job->total)
+            {
+                job->done_variable.wait(lock);
+            }
+        }
+
+        release(job);
+    }
+
+    void run_job(Job *job)
+    {
+        job->participate(job);
+        release(job);
+    }
+
+    static void release(Job *job)
+    {
+        if (job->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete job;
+        }
+    }
+
+    // Claims the next chunk: a share of what's left, but never less than grain. Returns false when the range is used up.
+    static bool claim(Job *job, std::size_t &chunk_begin, std::size_t &chunk_end)
+    {
+        std::size_t cur = job->next.load(std::memory_order_relaxed);
+        while (cur < job->end)
+        {
+            std::size_t remaining = job->end - cur;
+            std::size_t size = std::max(job->grain, remaining / (job->num_participants * 2));
+            size = std::min(size, remaining);
+
+            if (job->next.compare_exchange_weak(cur, cur + size, std::memory_order_relaxed))
+            {
+                chunk_begin = cur;
+                chunk_end = cur + size;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Called once a participant has run its last chunk (and merged its results), with how many indices it covered
+    static void finish(Job *job, std::size_t count)
+    {
+        if (!count) {return;}
+
+        if (job->done.fetch_add(count, std::memory_order_acq_rel) + count == job->total)
+        {
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                (void) lock;
+            }
+            job->done_variable.notify_all();
+        }
+    }
+
+    template <typename FunctionType>
+    static void participate_for(Job *job)
+    {
+        std::size_t count = 0;
+        std::size_t chunk_begin;
+        std::size_t chunk_end;
+        while (claim(job, chunk_begin, chunk_end))
+        {
+            ForContext<FunctionType> *context = static_cast<ForContext<FunctionType> *>(job->context);
+            context->fn(chunk_begin, chunk_end);
+            count += chunk_end - chunk_begin;
+        }
+
+        finish(job, count);
+    }
+
+    template <typename ValueType, typename FunctionType, typename ReduceType>
+    static void participate_reduce(Job *job)
+    {
+        ReduceContext<ValueType, FunctionType, ReduceType> *context = static_cast<ReduceContext<ValueType, FunctionType, ReduceType> *>(job->context);
+
+        std::optional<ValueType> partial;
+        std::size_t count = 0;
+        std::size_t chunk_begin;
+        std::size_t chunk_end;
+        while (claim(job, chunk_begin, chunk_end))
+        {
+            if (partial)
+            {
+                partial = context->reduce(std::move(*partial), context->fn(chunk_begin, chunk_end));
+            }
+            else
+            {
+                partial = context->fn(chunk_begin, chunk_end);
+            }
+            count += chunk_end - chunk_begin;
+        }
+
+        if (partial)
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            (void) lock;
+            context->result = context->reduce(std::move(context->result), std::move(*partial));
+        }
+
+        finish(job, count);
+    }
+};
+
+}
+
+#endif // JWUTIL_PARALLELLOOP_H
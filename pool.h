@@ -3,27 +3,65 @@
 
 #include <deque>
 #include <vector>
+#include <cstring>
+#include <type_traits>
 
 namespace jw_util
 {
 
-template <typename Type, bool shrink = false, typename ContainerType = std::deque<Type>>
+// With intrusive_free_list, freed slots are chained through their own storage instead of a separate vector,
+// so free() never allocates. The link is copied in and out with memcpy, so Type only has to be at least pointer-sized.
+// Freed slots stay in the container, which destroys everything in it, so they're refilled with default-constructed elements first.
+// A Type that's neither trivially destructible nor default-constructible gets destroyed twice, so it has to tolerate that.
+
+template <typename Type, bool shrink = false, typename ContainerType = std::deque<Type>, bool intrusive_free_list = false>
 class Pool
 {
+    static_assert(!intrusive_free_list || sizeof(Type) >= sizeof(Type *), "Pool<Type, shrink, ContainerType, true>: Type must be at least as big as a pointer to hold the free list");
+
 public:
+    ~Pool()
+    {
+        if constexpr (!std::is_trivially_destructible<Type>::value && std::is_default_constructible<Type>::value)
+        {
+            while (Type *type = pop_free())
+            {
+                new (type) Type();
+            }
+        }
+    }
+
     template <typename... ArgTypes>
     Type *alloc(ArgTypes &&... args)
     {
-        if (freed.empty())
+        Type *res = pop_free();
+        if (res)
+        {
+            return new (res) Type(std::forward<ArgTypes>(args)...);
+        }
+        else
         {
             pool.emplace_back(std::forward<ArgTypes>(args)...);
             return &pool.back();
         }
-        else
+    }
+
+    // Constructs count elements, each from a copy of args, and writes pointers to them to out
+    template <typename... ArgTypes>
+    void alloc_n(Type **out, unsigned int count, const ArgTypes &... args)
+    {
+        unsigned int i = 0;
+        while (i < count)
         {
-            Type *res = freed.back();
-            freed.pop_back();
-            return new (res) Type(std::forward<ArgTypes>(args)...);
+            Type *res = pop_free();
+            if (!res) {break;}
+            out[i++] = new (res) Type(args...);
+        }
+
+        while (i < count)
+        {
+            pool.emplace_back(args...);
+            out[i++] = &pool.back();
         }
     }
 
@@ -36,7 +74,15 @@ public:
         else
         {
             type->Type::~Type();
-            freed.push_back(const_cast<Type *>(type));
+            push_free(const_cast<Type *>(type));
+        }
+    }
+
+    void free_n(Type *const *types, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            free(types[i]);
         }
     }
 
@@ -45,7 +91,43 @@ public:
 
 private:
     ContainerType pool;
-    std::vector<Type *> freed;
+
+    // The head of the intrusive list, or a separate vector of freed slots
+    typename std::conditional<intrusive_free_list, Type *, std::vector<Type *>>::type freed {};
+
+    Type *pop_free()
+    {
+        if constexpr (intrusive_free_list)
+        {
+            Type *res = freed;
+            if (res)
+            {
+                std::memcpy(&freed, static_cast<void *>(res), sizeof(Type *));
+            }
+            return res;
+        }
+        else
+        {
+            if (freed.empty()) {return 0;}
+
+            Type *res = freed.back();
+            freed.pop_back();
+            return res;
+        }
+    }
+
+    void push_free(Type *type)
+    {
+        if constexpr (intrusive_free_list)
+        {
+            std::memcpy(static_cast<void *>(type), &freed, sizeof(Type *));
+            freed = type;
+        }
+        else
+        {
+            freed.push_back(type);
+        }
+    }
 };
 
 }
@@ -0,0 +1,201 @@
+#ifndef JWUTIL_POOLCHUNKED_H
+#define JWUTIL_POOLCHUNKED_H
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "blocksource.h"
+
+namespace jw_util
+{
+
+// Same alloc/free interface as Pool, but elements live in fixed-size chunks that each keep a bitmask of which slots are in use,
+// so for_each can visit just the live elements, in address order, with a count-trailing-zeros per element instead of a liveness check.
+// Elements never move. Chunks are kept around once allocated, and freed slots are reused lowest-address-first within a chunk.
+// Each chunk takes exactly chunk_bytes (a power of 2, big enough for 64 elements) including its header, and comes from BlockSource (see blocksource.h).
+
+template <typename Type, std::size_t chunk_bytes = 16384, typename BlockSource = BlockSourceHeap>
+class PoolChunked
+{
+public:
+    PoolChunked() {}
+
+    PoolChunked(const PoolChunked &) = delete;
+    PoolChunked &operator=(const PoolChunked &) = delete;
+
+    ~PoolChunked()
+    {
+        for (Chunk *chunk : chunks)
+        {
+            for_each_in_chunk(chunk, [](Type &type) {type.~Type();});
+            chunk->~Chunk();
+            BlockSource::free_block(chunk, chunk_bytes, chunk_alignment);
+        }
+    }
+
+    template <typename... ArgTypes>
+    Type *alloc(ArgTypes &&... args)
+    {
+        if (partial_chunks.empty())
+        {
+            add_chunk();
+        }
+
+        Chunk *chunk = partial_chunks.back();
+        unsigned int index = chunk->take_slot();
+        if (chunk->count == slots_per_chunk)
+        {
+            chunk->in_partial_list = false;
+            partial_chunks.pop_back();
+        }
+
+        num_live++;
+        return new (chunk->get(index)) Type(std::forward<ArgTypes>(args)...);
+    }
+
+    void free(const Type *type)
+    {
+        type->Type::~Type();
+
+        Chunk *chunk = get_chunk(type);
+        chunk->release_slot(type - chunk->get(0));
+        num_live--;
+
+        if (!chunk->in_partial_list)
+        {
+            chunk->in_partial_list = true;
+            partial_chunks.push_back(chunk);
+        }
+    }
+
+    // Calls fn(Type &) for every live element. fn must not alloc or free.
+    template <typename FunctionType>
+    void for_each(FunctionType &&fn)
+    {
+        for (Chunk *chunk : chunks)
+        {
+            for_each_in_chunk(chunk, fn);
+        }
+    }
+
+    template <typename FunctionType>
+    void for_each(FunctionType &&fn) const
+    {
+        for (const Chunk *chunk : chunks)
+        {
+            for_each_in_chunk(const_cast<Chunk *>(chunk), [&fn](const Type &type) {fn(type);});
+        }
+    }
+
+    std::size_t size() const {return num_live;}
+
+    static constexpr unsigned int get_slots_per_chunk() {return slots_per_chunk;}
+
+private:
+    static_assert(chunk_bytes && (chunk_bytes & (chunk_bytes - 1)) == 0, "PoolChunked<Type, chunk_bytes, BlockSource>: chunk_bytes must be a power of 2");
+
+    // What sizeof(Chunk) will be with this many slots
+    static constexpr std::size_t get_chunk_size(unsigned int slots)
+    {
+        std::size_t align = alignof(Type) > alignof(std::uint64_t) ? alignof(Type) : alignof(std::uint64_t);
+        std::size_t header = slots / 64 * sizeof(std::uint64_t) + sizeof(unsigned int) + sizeof(bool);
+        std::size_t storage_offset = (header + alignof(Type) - 1) / alignof(Type) * alignof(Type);
+        return (storage_offset + slots * sizeof(Type) + align - 1) / align * align;
+    }
+
+    // As many whole mask words of slots as fit in chunk_bytes along with the header
+    static constexpr unsigned int compute_slots_per_chunk()
+    {
+        unsigned int res = chunk_bytes / sizeof(Type) / 64 * 64;
+        while (res > 64 && get_chunk_size(res) > chunk_bytes)
+        {
+            res -= 64;
+        }
+        return res ? res : 64;
+    }
+
+    static constexpr unsigned int slots_per_chunk = compute_slots_per_chunk();
+    static constexpr unsigned int num_masks = slots_per_chunk / 64;
+
+    struct Chunk
+    {
+        std::uint64_t occupied[num_masks] = {};
+        unsigned int count = 0;
+        bool in_partial_list = false;
+        alignas(Type) unsigned char storage[slots_per_chunk * sizeof(Type)];
+
+        Type *get(std::size_t index) {return reinterpret_cast<Type *>(storage) + index;}
+
+        unsigned int take_slot()
+        {
+            for (unsigned int i = 0; i < num_masks; i++)
+            {
+                if (~occupied[i])
+                {
+                    unsigned int bit = __builtin_ctzll(~occupied[i]);
+                    occupied[i] |= static_cast<std::uint64_t>(1) << bit;
+                    count++;
+                    return i * 64 + bit;
+                }
+            }
+
+            assert(false);
+            return 0;
+        }
+
+        void release_slot(std::size_t index)
+        {
+            assert(index < slots_per_chunk);
+            assert(occupied[index / 64] & (static_cast<std::uint64_t>(1) << (index % 64)));
+
+            occupied[index / 64] &= ~(static_cast<std::uint64_t>(1) << (index % 64));
+            count--;
+        }
+    };
+
+    static_assert(sizeof(Chunk) <= chunk_bytes, "PoolChunked<Type, chunk_bytes, BlockSource>: chunk_bytes must fit 64 elements plus the chunk header");
+
+    // Chunks are aligned to chunk_bytes, so an element's chunk is found by masking its address
+    static constexpr std::size_t chunk_alignment = chunk_bytes;
+
+    std::vector<Chunk *> chunks;
+    std::vector<Chunk *> partial_chunks;
+    std::size_t num_live = 0;
+
+    void add_chunk()
+    {
+        void *mem = BlockSource::alloc_block(chunk_bytes, chunk_alignment);
+        Chunk *chunk = new (mem) Chunk();
+        chunk->in_partial_list = true;
+        chunks.push_back(chunk);
+        partial_chunks.push_back(chunk);
+    }
+
+    static Chunk *get_chunk(const Type *type)
+    {
+        return reinterpret_cast<Chunk *>(reinterpret_cast<std::uintptr_t>(type) & ~(chunk_alignment - 1));
+    }
+
+    template <typename FunctionType>
+    static void for_each_in_chunk(Chunk *chunk, FunctionType &&fn)
+    {
+        for (unsigned int i = 0; i < num_masks; i++)
+        {
+            std::uint64_t mask = chunk->occupied[i];
+            while (mask)
+            {
+                unsigned int bit = __builtin_ctzll(mask);
+                mask &= mask - 1;
+                fn(*chunk->get(i * 64 + bit));
+            }
+        }
+    }
+};
+
+}
+
+#endif // JWUTIL_POOLCHUNKED_H
@@ -2,28 +2,44 @@
 #define JWUTIL_POOLFIFO_H
 
 #include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#include "blocksource.h"
 
 namespace jw_util
 {
 
 // Thread-safe, if only one thread calls alloc and one thread calls free
+// A block the free side is done with is handed back to the alloc side for reuse, rather than deleted, so steady-state use doesn't allocate.
+// Either way, alloc returns a default-constructed element: the free side destroys and re-constructs a block's elements before handing it back.
+// See PoolFIFOConcurrent for more than one thread on either side. Blocks come from BlockSource (see blocksource.h).
 
-template <typename Type>
+template <typename Type, typename BlockSource = BlockSourceHeap>
 class PoolFIFO
 {
 public:
     PoolFIFO()
-        : alloc_cur(new Type[alloc_size])
+        : alloc_cur(create_block())
         , alloc_end(alloc_cur + alloc_size)
         , free_cur(alloc_cur)
         , free_end(alloc_end)
     {}
 
+    PoolFIFO(const PoolFIFO &) = delete;
+    PoolFIFO &operator=(const PoolFIFO &) = delete;
+
     Type *alloc()
     {
         if (alloc_cur == alloc_end)
         {
-            alloc_cur = new Type[alloc_size];
+            alloc_cur = spare_block.exchange(0, std::memory_order_acquire);
+            if (!alloc_cur)
+            {
+                alloc_cur = create_block();
+            }
             alloc_end = alloc_cur + alloc_size;
         }
         return alloc_cur++;
@@ -33,8 +49,14 @@ public:
     {
         if (free_cur == free_end)
         {
-            const Type *free_start = free_end - alloc_size;
-            delete[] free_start;
+            // Only one block is kept spare; if the alloc side hasn't taken the last one yet, it's not going to need two
+            Type *free_start = const_cast<Type *>(free_end - alloc_size);
+            reset_block(free_start);
+            Type *prev_spare = spare_block.exchange(free_start, std::memory_order_acq_rel);
+            if (prev_spare)
+            {
+                destroy_block(prev_spare);
+            }
 
             free_cur = type;
             free_end = free_cur + alloc_size;
@@ -56,6 +78,43 @@ private:
 
     const Type *free_cur;
     const Type *free_end;
+
+    // Padding so the handoff doesn't share a line with either side
+    char _padding_2[64];
+
+    std::atomic<Type *> spare_block {0};
+
+    static Type *create_block()
+    {
+        Type *block = static_cast<Type *>(BlockSource::alloc_block(alloc_size * sizeof(Type), alignof(Type)));
+        for (unsigned int i = 0; i < alloc_size; i++)
+        {
+            new (block + i) Type;
+        }
+        return block;
+    }
+
+    // Gives a recycled block fresh elements, like a newly created one. Trivial types are left as they are, since new[] wouldn't have initialized them either.
+    static void reset_block(Type *block)
+    {
+        if constexpr (!std::is_trivially_default_constructible<Type>::value || !std::is_trivially_destructible<Type>::value)
+        {
+            for (unsigned int i = 0; i < alloc_size; i++)
+            {
+                block[i].~Type();
+                new (block + i) Type;
+            }
+        }
+    }
+
+    static void destroy_block(Type *block)
+    {
+        for (unsigned int i = 0; i < alloc_size; i++)
+        {
+            block[i].~Type();
+        }
+        BlockSource::free_block(block, alloc_size * sizeof(Type), alignof(Type));
+    }
 };
 
 }
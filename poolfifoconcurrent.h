@@ -0,0 +1,173 @@
+#ifndef JWUTIL_POOLFIFOCONCURRENT_H
+#define JWUTIL_POOLFIFOCONCURRENT_H
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "blocksource.h"
+
+namespace jw_util
+{
+
+// Like PoolFIFO, but any number of threads can call alloc and free at the same time, and frees can come in any order.
+// Blocks are aligned to their size and start with a header counting how many of their elements have been freed;
+// once every element of a block has been handed out and freed, the block goes on a list to be reused.
+// Blocks are never given back to the system until the pool is destroyed, which is what makes it safe for a slow thread to still be looking at an old block.
+// The elements are default-constructed when their block is created, and destroyed with the pool, so alloc and free don't construct or destroy anything.
+// Blocks come from BlockSource (see blocksource.h).
+
+template <typename Type, std::size_t block_bytes = 65536, typename BlockSource = BlockSourceHeap>
+class PoolFIFOConcurrent
+{
+    static_assert(block_bytes && (block_bytes & (block_bytes - 1)) == 0, "PoolFIFOConcurrent<Type, block_bytes>: block_bytes must be a power of 2");
+
+public:
+    PoolFIFOConcurrent()
+    {
+        cur_block.store(create_block(), std::memory_order_relaxed);
+    }
+
+    PoolFIFOConcurrent(const PoolFIFOConcurrent &) = delete;
+    PoolFIFOConcurrent &operator=(const PoolFIFOConcurrent &) = delete;
+
+    ~PoolFIFOConcurrent()
+    {
+        for (Block *block : all_blocks)
+        {
+            block->~Block();
+            BlockSource::free_block(block, block_bytes, block_bytes);
+        }
+    }
+
+    Type *alloc()
+    {
+        while (true)
+        {
+            Block *block = cur_block.load(std::memory_order_acquire);
+
+            // A CAS rather than a fetch_add, so a thread holding an old block can't bump its index after it's been recycled.
+            // Acquire pairs with the release in free() that recycles the block, so the last user's writes to the slot happen before ours.
+            unsigned int index = block->next.load(std::memory_order_relaxed);
+            while (index < capacity)
+            {
+                if (block->next.compare_exchange_weak(index, index + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    return block->get(index);
+                }
+            }
+
+            replace_block(block);
+        }
+    }
+
+    void free(const Type *type)
+    {
+        Block *block = get_block(type);
+        if (block->freed.fetch_add(1, std::memory_order_acq_rel) + 1 == capacity)
+        {
+            // Every element has been handed out and freed, so nobody else can claim anything from it until next is reset
+            block->freed.store(0, std::memory_order_relaxed);
+            block->next.store(0, std::memory_order_release);
+
+            // If it's still the current block, allocs just carry on using it, and it'll be recycled when it fills up again
+            std::lock_guard<std::mutex> lock(mutex);
+            (void) lock;
+            if (cur_block.load(std::memory_order_relaxed) != block)
+            {
+                spare_blocks.push_back(block);
+            }
+        }
+    }
+
+    static constexpr unsigned int get_capacity() {return capacity;}
+
+private:
+    struct BlockHeader
+    {
+        alignas(64) std::atomic<unsigned int> next {0};
+        alignas(64) std::atomic<unsigned int> freed {0};
+    };
+
+    static constexpr std::size_t elements_offset = (sizeof(BlockHeader) + alignof(Type) - 1) / alignof(Type) * alignof(Type);
+    static constexpr unsigned int capacity = (block_bytes - elements_offset) / sizeof(Type);
+    static_assert(block_bytes > elements_offset && capacity >= 1, "PoolFIFOConcurrent<Type, block_bytes>: block_bytes is too small to hold a Type");
+
+    struct Block : BlockHeader
+    {
+        Block()
+        {
+            for (unsigned int i = 0; i < capacity; i++)
+            {
+                new (get(i)) Type;
+            }
+        }
+
+        ~Block()
+        {
+            for (unsigned int i = 0; i < capacity; i++)
+            {
+                get(i)->~Type();
+            }
+        }
+
+        Type *get(unsigned int index)
+        {
+            return reinterpret_cast<Type *>(reinterpret_cast<char *>(this) + elements_offset) + index;
+        }
+    };
+
+    alignas(64) std::atomic<Block *> cur_block;
+
+    // Guards everything below
+    alignas(64) std::mutex mutex;
+    std::vector<Block *> spare_blocks;
+    std::vector<Block *> all_blocks;
+
+    Block *create_block()
+    {
+        void *mem = BlockSource::alloc_block(block_bytes, block_bytes);
+        Block *block = new (mem) Block();
+        all_blocks.push_back(block);
+        return block;
+    }
+
+    void replace_block(Block *full_block)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        (void) lock;
+
+        // Someone else already replaced it
+        if (cur_block.load(std::memory_order_relaxed) != full_block) {return;}
+
+        // Its last free recycled it while we were waiting for the mutex, and left it current since it was, so keep using it.
+        // Otherwise that free will see it's no longer current once it gets the mutex, and put it on the spare list.
+        if (full_block->next.load(std::memory_order_relaxed) < capacity) {return;}
+
+        Block *block;
+        if (spare_blocks.empty())
+        {
+            block = create_block();
+        }
+        else
+        {
+            block = spare_blocks.back();
+            spare_blocks.pop_back();
+        }
+
+        cur_block.store(block, std::memory_order_release);
+    }
+
+    static Block *get_block(const Type *type)
+    {
+        return reinterpret_cast<Block *>(reinterpret_cast<std::uintptr_t>(type) & ~(block_bytes - 1));
+    }
+};
+
+}
+
+#endif // JWUTIL_POOLFIFOCONCURRENT_H
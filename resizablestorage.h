@@ -3,11 +3,42 @@
 
 #include <assert.h>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
 
 namespace jw_util
 {
 
-template <typename DataType, bool fill_zero = false>
+// Growth policies for ResizableStorage. get_size returns the size to grow to, which must be at least min_size.
+
+template <std::size_t numerator, std::size_t denominator>
+struct ResizableStorageGrowthFactor
+{
+    static_assert(numerator > denominator, "ResizableStorageGrowthFactor<numerator, denominator>: Must grow");
+
+    static std::size_t get_size(std::size_t cur_size, std::size_t min_size)
+    {
+        std::size_t res = cur_size / denominator * numerator + cur_size % denominator * numerator / denominator;
+        return res > min_size ? res : min_size;
+    }
+};
+
+struct ResizableStorageGrowthExact
+{
+    static std::size_t get_size(std::size_t cur_size, std::size_t min_size)
+    {
+        (void) cur_size;
+        return min_size;
+    }
+};
+
+// Trivial types (trivially copyable, and with nothing for new[] to initialize) are kept in malloc'd memory and grown with realloc,
+// which can extend in place, and for large buffers is an mremap rather than a copy. Everything else is moved into a new array.
+
+template <typename DataType, bool fill_zero = false, typename GrowthPolicy = ResizableStorageGrowthFactor<3, 2>>
 class ResizableStorage
 {
 public:
@@ -16,34 +47,63 @@ public:
         , size(0)
     {}
 
-    ResizableStorage(unsigned int init_size)
-        : data(new DataType[init_size])
+    ResizableStorage(std::size_t init_size)
+        : data(allocate(init_size))
         , size(init_size)
     {
-        if (fill_zero)
+        if constexpr (fill_zero)
         {
             std::fill_n(data, init_size, static_cast<DataType>(0));
         }
     }
 
+    ResizableStorage(const ResizableStorage &) = delete;
+    ResizableStorage &operator=(const ResizableStorage &) = delete;
+
+    ~ResizableStorage()
+    {
+        if constexpr (use_realloc)
+        {
+            std::free(data);
+        }
+        else
+        {
+            delete[] data;
+        }
+    }
+
     template <typename... UpdatePtrs>
-    void resize(unsigned int new_size, UpdatePtrs &... ptrs)
+    void resize(std::size_t new_size, UpdatePtrs &... ptrs)
     {
         if (new_size <= size) {return;}
 
-        unsigned int new_size_2 = size + (size / 2);
-        if (new_size < new_size_2) {new_size = new_size_2;}
+        new_size = GrowthPolicy::get_size(size, new_size);
+        assert(new_size > size);
+
+        DataType *new_data;
+        if constexpr (use_realloc)
+        {
+            new_data = static_cast<DataType *>(std::realloc(data, new_size * sizeof(DataType)));
+            if (!new_data) {throw std::bad_alloc();}
+        }
+        else
+        {
+            new_data = new DataType[new_size];
+            std::move(data, data + size, new_data);
+        }
 
-        DataType *new_data = new DataType[new_size];
-        std::move(data, data + size, new_data);
-        if (fill_zero)
+        if constexpr (fill_zero)
         {
             std::fill(new_data + size, new_data + new_size, static_cast<DataType>(0));
         }
 
-        update_ptrs(reinterpret_cast<const char *>(data), reinterpret_cast<char *>(new_data), ptrs...);
+        // The old pointer is only used for its address here, so it doesn't matter that realloc already freed it
+        update_ptrs(reinterpret_cast<std::uintptr_t>(data), reinterpret_cast<char *>(new_data), ptrs...);
 
-        delete[] data;
+        if constexpr (!use_realloc)
+        {
+            delete[] data;
+        }
 
         data = new_data;
         size = new_size;
@@ -52,17 +112,35 @@ public:
     DataType *begin() const {return data;}
     DataType *end() const {return data + size;}
 
+    std::size_t get_size() const {return size;}
+
 private:
+    static constexpr bool use_realloc = std::is_trivial<DataType>::value && alignof(DataType) <= alignof(std::max_align_t);
+
     DataType *data;
-    unsigned int size;
+    std::size_t size;
+
+    static DataType *allocate(std::size_t count)
+    {
+        if constexpr (use_realloc)
+        {
+            DataType *res = static_cast<DataType *>(std::malloc(count * sizeof(DataType)));
+            if (!res && count) {throw std::bad_alloc();}
+            return res;
+        }
+        else
+        {
+            return new DataType[count];
+        }
+    }
 
     template <typename PtrType, typename... UpdatePtrs>
 #ifdef NDEBUG
     static
 #endif
-    void update_ptrs(const char *old_data, char *new_data, PtrType *&ptr, UpdatePtrs &... rest)
+    void update_ptrs(std::uintptr_t old_data, char *new_data, PtrType *&ptr, UpdatePtrs &... rest)
     {
-        unsigned int offset = reinterpret_cast<const char *>(ptr) - old_data;
+        std::size_t offset = reinterpret_cast<std::uintptr_t>(ptr) - old_data;
 #ifndef NDEBUG
         assert(offset <= size * sizeof(DataType));
 #endif
@@ -70,7 +148,11 @@ private:
         update_ptrs(old_data, new_data, rest...);
     }
 
-    static void update_ptrs(const char *old_data, char *new_data) {}
+    static void update_ptrs(std::uintptr_t old_data, char *new_data)
+    {
+        (void) old_data;
+        (void) new_data;
+    }
 };
 
 }
@@ -0,0 +1,148 @@
+#ifndef JWUTIL_RINGMPMC_H
+#define JWUTIL_RINGMPMC_H
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace jw_util
+{
+
+// Bounded, lock-free, multi-producer/multi-consumer ring buffer (Dmitry Vyukov's algorithm)
+// Every cell carries a sequence number that tells producers and consumers whose turn it is, so a push or pop is one CAS on the shared position plus one store on the cell.
+// The cells are allocated once at construction, and capacity must be a power of 2.
+
+template <typename Type, unsigned int capacity>
+class RingMPMC
+{
+    static_assert(capacity && (capacity & (capacity - 1)) == 0, "RingMPMC<Type, capacity>: capacity must be a power of 2");
+
+public:
+    static constexpr bool is_lock_free = true;
+
+    RingMPMC()
+        : cells(new Cell[capacity])
+    {
+        for (std::size_t i = 0; i < capacity; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingMPMC(const RingMPMC &) = delete;
+    RingMPMC &operator=(const RingMPMC &) = delete;
+
+    ~RingMPMC()
+    {
+        std::size_t end = enqueue_pos.load(std::memory_order_relaxed);
+        for (std::size_t pos = dequeue_pos.load(std::memory_order_relaxed); pos != end; pos++)
+        {
+            cells[pos & (capacity - 1)].get()->Type::~Type();
+        }
+    }
+
+    // Returns false without touching args if the ring is full
+    template <typename... ArgTypes>
+    bool try_emplace(ArgTypes &&... args)
+    {
+        std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        while (true)
+        {
+            cell = &cells[pos & (capacity - 1)];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {break;}
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (cell->get()) Type(std::forward<ArgTypes>(args)...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false without touching out if the ring is empty
+    bool try_pop(Type &out)
+    {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        while (true)
+        {
+            cell = &cells[pos & (capacity - 1)];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {break;}
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        out = std::move(*cell->get());
+        cell->get()->Type::~Type();
+        cell->sequence.store(pos + capacity, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot, other threads may have changed it by the time this returns
+    bool empty() const
+    {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        std::size_t seq = cells[pos & (capacity - 1)].sequence.load(std::memory_order_acquire);
+        return static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1) < 0;
+    }
+
+    // Also only a snapshot
+    std::size_t size() const
+    {
+        std::size_t enqueued = enqueue_pos.load(std::memory_order_relaxed);
+        std::size_t dequeued = dequeue_pos.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    static constexpr unsigned int get_capacity() {return capacity;}
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        alignas(Type) unsigned char storage[sizeof(Type)];
+
+        Type *get() {return reinterpret_cast<Type *>(storage);}
+    };
+
+    std::unique_ptr<Cell[]> cells;
+
+    // Padding so producers and consumers don't bounce the same cache line
+    alignas(64) std::atomic<std::size_t> enqueue_pos {0};
+    alignas(64) std::atomic<std::size_t> dequeue_pos {0};
+    char _padding[64 - sizeof(std::atomic<std::size_t>)];
+};
+
+}
+
+#endif // JWUTIL_RINGMPMC_H
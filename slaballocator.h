@@ -0,0 +1,212 @@
+#ifndef JWUTIL_SLABALLOCATOR_H
+#define JWUTIL_SLABALLOCATOR_H
+
+#include <assert.h>
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace jw_util
+{
+
+// Thread-safe allocator for small objects, in power-of-2 size classes from 8 to 4096 bytes.
+// Each thread keeps a freelist per size class, and only goes to the mutex-guarded central depot to trade whole batches of blocks,
+// so memory freed on another thread than it was allocated on just flows back through the depot.
+// Blocks come from 64 KiB slabs that are never given back to the system. Bigger sizes go straight to operator new.
+// free() has to be passed the same size that alloc() was.
+
+class SlabAllocator
+{
+public:
+    SlabAllocator() = delete;
+
+    static void *alloc(std::size_t size)
+    {
+        unsigned int size_class = get_size_class(size);
+        if (size_class >= num_size_classes)
+        {
+            return ::operator new(size);
+        }
+
+        FreeList &list = get_thread_cache().lists[size_class];
+        if (!list.head)
+        {
+            refill(size_class, list);
+        }
+
+        FreeBlock *block = list.head;
+        list.head = block->next;
+        list.count--;
+        return block;
+    }
+
+    static void free(void *ptr, std::size_t size)
+    {
+        unsigned int size_class = get_size_class(size);
+        if (size_class >= num_size_classes)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+
+        FreeList &list = get_thread_cache().lists[size_class];
+        FreeBlock *block = static_cast<FreeBlock *>(ptr);
+        block->next = list.head;
+        list.head = block;
+        list.count++;
+
+        if (list.count >= batch_size * 2)
+        {
+            flush(size_class, list, batch_size);
+        }
+    }
+
+    template <typename Type, typename... ArgTypes>
+    static Type *create(ArgTypes &&... args)
+    {
+        static_assert(alignof(Type) <= alignof(std::max_align_t), "SlabAllocator: Over-aligned types aren't supported");
+        return new (alloc(sizeof(Type))) Type(std::forward<ArgTypes>(args)...);
+    }
+
+    template <typename Type>
+    static void destroy(Type *type)
+    {
+        type->~Type();
+        free(type, sizeof(Type));
+    }
+
+private:
+    static constexpr unsigned int min_size_bits = 3;
+    static constexpr unsigned int num_size_classes = 10;
+    static constexpr unsigned int batch_size = 32;
+    static constexpr std::size_t slab_bytes = 65536;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct FreeList
+    {
+        FreeBlock *head;
+        unsigned int count;
+    };
+
+    struct ThreadCache
+    {
+        FreeList lists[num_size_classes];
+
+        ThreadCache()
+        {
+            for (FreeList &list : lists)
+            {
+                list.head = 0;
+                list.count = 0;
+            }
+        }
+
+        // Whatever this thread still holds goes back to the depot, so other threads can use it
+        ~ThreadCache()
+        {
+            for (unsigned int i = 0; i < num_size_classes; i++)
+            {
+                while (lists[i].count)
+                {
+                    flush(i, lists[i], std::min(lists[i].count, batch_size));
+                }
+            }
+        }
+    };
+
+    struct Depot
+    {
+        std::mutex mutex;
+        std::vector<FreeList> batches;
+    };
+
+    static ThreadCache &get_thread_cache()
+    {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+
+    static Depot &get_depot(unsigned int size_class)
+    {
+        static Depot depots[num_size_classes];
+        return depots[size_class];
+    }
+
+    static unsigned int get_size_class(std::size_t size)
+    {
+        if (size <= (static_cast<std::size_t>(1) << min_size_bits)) {return 0;}
+        return (sizeof(unsigned long long) * 8 - __builtin_clzll(size - 1)) - min_size_bits;
+    }
+
+    // Moves count blocks from the front of list to the depot as one batch
+    static void flush(unsigned int size_class, FreeList &list, unsigned int count)
+    {
+        assert(count && count <= list.count);
+
+        FreeList batch;
+        batch.head = list.head;
+        batch.count = count;
+
+        FreeBlock *last = list.head;
+        for (unsigned int i = 1; i < count; i++)
+        {
+            last = last->next;
+        }
+        list.head = last->next;
+        list.count -= count;
+        last->next = 0;
+
+        Depot &depot = get_depot(size_class);
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        (void) lock;
+        depot.batches.push_back(batch);
+    }
+
+    // Takes a batch from the depot, carving a new slab into batches first if it's empty. The list must be empty.
+    static void refill(unsigned int size_class, FreeList &list)
+    {
+        assert(!list.head);
+
+        Depot &depot = get_depot(size_class);
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        (void) lock;
+
+        if (depot.batches.empty())
+        {
+            std::size_t block_size = static_cast<std::size_t>(1) << (size_class + min_size_bits);
+            std::size_t num_blocks = slab_bytes / block_size;
+            char *slab = static_cast<char *>(::operator new(slab_bytes));
+
+            for (std::size_t i = 0; i < num_blocks; i += batch_size)
+            {
+                std::size_t end = std::min<std::size_t>(i + batch_size, num_blocks);
+
+                FreeList batch;
+                batch.head = reinterpret_cast<FreeBlock *>(slab + i * block_size);
+                batch.count = end - i;
+
+                for (std::size_t j = i; j < end; j++)
+                {
+                    FreeBlock *block = reinterpret_cast<FreeBlock *>(slab + j * block_size);
+                    block->next = j + 1 < end ? reinterpret_cast<FreeBlock *>(slab + (j + 1) * block_size) : 0;
+                }
+
+                depot.batches.push_back(batch);
+            }
+        }
+
+        list = depot.batches.back();
+        depot.batches.pop_back();
+    }
+};
+
+}
+
+#endif // JWUTIL_SLABALLOCATOR_H
@@ -1,7 +1,13 @@
 #ifndef JWUTIL_STACKBASEDVECTOR_H
 #define JWUTIL_STACKBASEDVECTOR_H
 
-#include <vector>
+#include <assert.h>
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 // http://stackoverflow.com/questions/354442/looking-for-c-stl-like-vector-class-but-using-stack-storage
 // http://stackoverflow.com/questions/8049657/stack-buffer-based-stl-allocator
@@ -9,81 +15,290 @@
 namespace jw_util
 {
 
-template <typename DataType, std::size_t stack_size>
-using StackBasedVector = std::vector<DataType>;
+// A vector that keeps up to stack_size elements inline, and only allocates once it grows past that.
+// When it does, all the elements move to the heap together, so the elements are always contiguous and iterators are plain pointers.
+// Like std::vector, growing invalidates pointers to the elements. Works with move-only types.
+// Moving is noexcept if moving a DataType is, so containers of these move rather than copy them when they grow.
 
-/*
-template <typename Type, std::size_t stack_size>
+template <typename DataType, std::size_t stack_size>
 class StackBasedVector
 {
 public:
-	StackBasedVector()
-	{
-		// This class is not tested yet
-		assert(false);
-	}
-
-	Type &operator[](std::size_t i)
-	{
-		if (i < stack_size)
-		{
-			// Use stack
-			return stack[i];
-		}
-		else
-		{
-			// Use heap
-			assert(i < size);
-			return heap[i - stack_size];
-		}
-	}
-
-	void push_back(Type &val)
-	{
-		if (size < stack_size)
-		{
-			// Use stack
-			stack[size] = val;
-		}
-		else
-		{
-			// Use heap
-			std::size_t heap_i = size - stack_size;
-			if (heap_i >= alloc)
-			{
-				if (alloc)
-				{
-					Heap *new_heap = new Type[alloc * 2];
-					std::copy_n(heap, new_heap, alloc);
-					delete[] heap;
-					heap = new_heap;
-					alloc *= 2;
-				}
-				else
-				{
-					alloc = 16;
-					heap = new Type[alloc];
-				}
-			}
-
-			heap[heap_i] = val;
-		}
-		size++;
-	}
-
-	void pop_back()
-	{
-		size--;
-	}
+    typedef DataType value_type;
+    typedef std::size_t size_type;
+    typedef DataType *iterator;
+    typedef const DataType *const_iterator;
+
+    StackBasedVector()
+        : ptr(get_stack())
+    {}
+
+    explicit StackBasedVector(std::size_t count)
+        : StackBasedVector()
+    {
+        resize(count);
+    }
+
+    StackBasedVector(std::size_t count, const DataType &value)
+        : StackBasedVector()
+    {
+        resize(count, value);
+    }
+
+    StackBasedVector(std::initializer_list<DataType> init)
+        : StackBasedVector()
+    {
+        reserve(init.size());
+        for (const DataType &value : init)
+        {
+            new (ptr + count) DataType(value);
+            count++;
+        }
+    }
+
+    StackBasedVector(const StackBasedVector &other)
+        : StackBasedVector()
+    {
+        reserve(other.count);
+        for (const DataType &value : other)
+        {
+            new (ptr + count) DataType(value);
+            count++;
+        }
+    }
+
+    StackBasedVector(StackBasedVector &&other) noexcept(std::is_nothrow_move_constructible<DataType>::value)
+        : StackBasedVector()
+    {
+        take(std::move(other));
+    }
+
+    ~StackBasedVector()
+    {
+        clear();
+        free_heap();
+    }
+
+    StackBasedVector &operator=(const StackBasedVector &other)
+    {
+        if (this != &other)
+        {
+            clear();
+            reserve(other.count);
+            for (const DataType &value : other)
+            {
+                new (ptr + count) DataType(value);
+                count++;
+            }
+        }
+        return *this;
+    }
+
+    StackBasedVector &operator=(StackBasedVector &&other) noexcept(std::is_nothrow_move_constructible<DataType>::value)
+    {
+        if (this != &other)
+        {
+            clear();
+            free_heap();
+            take(std::move(other));
+        }
+        return *this;
+    }
+
+    DataType &operator[](std::size_t i)
+    {
+        assert(i < count);
+        return ptr[i];
+    }
+
+    const DataType &operator[](std::size_t i) const
+    {
+        assert(i < count);
+        return ptr[i];
+    }
+
+    DataType &front() {assert(count); return ptr[0];}
+    const DataType &front() const {assert(count); return ptr[0];}
+    DataType &back() {assert(count); return ptr[count - 1];}
+    const DataType &back() const {assert(count); return ptr[count - 1];}
+
+    DataType *data() {return ptr;}
+    const DataType *data() const {return ptr;}
+
+    iterator begin() {return ptr;}
+    const_iterator begin() const {return ptr;}
+    const_iterator cbegin() const {return ptr;}
+    iterator end() {return ptr + count;}
+    const_iterator end() const {return ptr + count;}
+    const_iterator cend() const {return ptr + count;}
+
+    std::size_t size() const {return count;}
+    bool empty() const {return count == 0;}
+    std::size_t capacity() const {return cap;}
+    bool is_on_stack() const {return ptr == get_stack();}
+
+    void reserve(std::size_t new_cap)
+    {
+        if (new_cap <= cap) {return;}
+
+        DataType *new_ptr = static_cast<DataType *>(::operator new(new_cap * sizeof(DataType), std::align_val_t(alignof(DataType))));
+        for (std::size_t i = 0; i < count; i++)
+        {
+            new (new_ptr + i) DataType(std::move(ptr[i]));
+            ptr[i].~DataType();
+        }
+
+        free_heap();
+        ptr = new_ptr;
+        cap = new_cap;
+    }
+
+    template <typename... ArgTypes>
+    DataType &emplace_back(ArgTypes &&... args)
+    {
+        if (count == cap)
+        {
+            // Construct first, in case args refers to an element that's about to move
+            DataType value(std::forward<ArgTypes>(args)...);
+            reserve(cap * 2);
+            new (ptr + count) DataType(std::move(value));
+        }
+        else
+        {
+            new (ptr + count) DataType(std::forward<ArgTypes>(args)...);
+        }
+
+        return ptr[count++];
+    }
+
+    void push_back(const DataType &value) {emplace_back(value);}
+    void push_back(DataType &&value) {emplace_back(std::move(value));}
+
+    void pop_back()
+    {
+        assert(count);
+        count--;
+        ptr[count].~DataType();
+    }
+
+    template <typename... ArgTypes>
+    iterator emplace(const_iterator pos, ArgTypes &&... args)
+    {
+        std::size_t index = pos - ptr;
+        assert(index <= count);
+
+        emplace_back(std::forward<ArgTypes>(args)...);
+        std::rotate(ptr + index, ptr + count - 1, ptr + count);
+        return ptr + index;
+    }
+
+    iterator insert(const_iterator pos, const DataType &value) {return emplace(pos, value);}
+    iterator insert(const_iterator pos, DataType &&value) {return emplace(pos, std::move(value));}
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        DataType *dst = ptr + (first - ptr);
+        DataType *new_end = std::move(ptr + (last - ptr), ptr + count, dst);
+        while (ptr + count != new_end)
+        {
+            pop_back();
+        }
+        return dst;
+    }
+
+    iterator erase(const_iterator pos) {return erase(pos, pos + 1);}
+
+    void resize(std::size_t new_count)
+    {
+        reserve(new_count);
+        while (count < new_count)
+        {
+            new (ptr + count) DataType();
+            count++;
+        }
+        while (count > new_count)
+        {
+            pop_back();
+        }
+    }
+
+    void resize(std::size_t new_count, const DataType &value)
+    {
+        if (new_count > cap)
+        {
+            // value might be one of the elements, which reserve is about to move out from under it
+            DataType copy(value);
+            reserve(new_count);
+            resize(new_count, copy);
+            return;
+        }
+
+        while (count < new_count)
+        {
+            new (ptr + count) DataType(value);
+            count++;
+        }
+        while (count > new_count)
+        {
+            pop_back();
+        }
+    }
+
+    // Destroys the elements, but keeps the heap buffer if there is one
+    void clear()
+    {
+        while (count)
+        {
+            pop_back();
+        }
+    }
 
 private:
-	std::size_t size = 0;
-	std::size_t alloc = 0;
+    static_assert(stack_size > 0, "StackBasedVector<DataType, stack_size>: stack_size must be positive");
+
+    DataType *ptr;
+    std::size_t count = 0;
+    std::size_t cap = stack_size;
+    alignas(DataType) unsigned char stack[stack_size * sizeof(DataType)];
+
+    DataType *get_stack() {return reinterpret_cast<DataType *>(stack);}
+    const DataType *get_stack() const {return reinterpret_cast<const DataType *>(stack);}
+
+    void free_heap()
+    {
+        if (ptr != get_stack())
+        {
+            ::operator delete(static_cast<void *>(ptr), std::align_val_t(alignof(DataType)));
+            ptr = get_stack();
+            cap = stack_size;
+        }
+    }
+
+    // Expects this to be empty and on the stack. Leaves other empty.
+    void take(StackBasedVector &&other)
+    {
+        assert(count == 0 && ptr == get_stack());
 
-	std::array<Type, stack_size> stack;
-	Type *heap;
+        if (other.ptr != other.get_stack())
+        {
+            ptr = other.ptr;
+            cap = other.cap;
+            count = other.count;
+            other.ptr = other.get_stack();
+            other.cap = stack_size;
+            other.count = 0;
+        }
+        else
+        {
+            for (DataType &value : other)
+            {
+                new (ptr + count) DataType(std::move(value));
+                count++;
+            }
+            other.clear();
+        }
+    }
 };
-*/
 
 }
 
@@ -0,0 +1,226 @@
+#ifndef JWUTIL_TASKGRAPH_H
+#define JWUTIL_TASKGRAPH_H
+
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "methodcallback.h"
+#include "workqueue.h"
+
+namespace jw_util
+{
+
+// A DAG of callbacks, run on a WorkQueue so each node starts as soon as all of its predecessors have finished.
+// Build it once with add_node/add_edge, then call run() as many times as needed; the adjacency is only rebuilt after the shape changes.
+// When a node finishes, it runs one of its newly-ready successors on the same thread and pushes the rest onto the queue.
+
+template <unsigned int num_threads>
+class TaskGraph
+{
+public:
+    typedef unsigned int NodeId;
+
+    TaskGraph()
+        : queue(jw_util::MethodCallback<NodeId>::template create<TaskGraph, &TaskGraph::run_node>(this))
+    {}
+
+    NodeId add_node(jw_util::MethodCallback<> callback)
+    {
+        Node node;
+        node.callback = callback;
+        nodes.push_back(node);
+
+        dirty = true;
+        return nodes.size() - 1;
+    }
+
+    // Makes after wait for before to finish
+    void add_edge(NodeId before, NodeId after)
+    {
+        assert(before < nodes.size());
+        assert(after < nodes.size());
+
+        edges.emplace_back(before, after);
+        dirty = true;
+    }
+
+    // Runs every node once and blocks until they've all finished. Must not be called from one of the nodes, or concurrently with itself.
+    void run()
+    {
+        if (nodes.empty()) {return;}
+
+        if (dirty)
+        {
+            build();
+        }
+
+        remaining_nodes.store(nodes.size(), std::memory_order_relaxed);
+        for (NodeId i = 0; i < nodes.size(); i++)
+        {
+            pending_predecessors[i].store(nodes[i].num_predecessors, std::memory_order_relaxed);
+        }
+
+        for (NodeId root : roots)
+        {
+            queue.push(root);
+        }
+
+        std::unique_lock<std::mutex> lock(done_mutex);
+        while (remaining_nodes.load(std::memory_order_acquire))
+        {
+            done_variable.wait(lock);
+        }
+    }
+
+private:
+    struct Node
+    {
+        jw_util::MethodCallback<> callback;
+        unsigned int num_predecessors = 0;
+
+        // Range into successors
+        unsigned int successors_begin = 0;
+        unsigned int successors_end = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::pair<NodeId, NodeId>> edges;
+    bool dirty = false;
+
+    std::vector<NodeId> successors;
+    std::vector<NodeId> roots;
+    std::unique_ptr<std::atomic<unsigned int>[]> pending_predecessors;
+
+    std::atomic<unsigned int> remaining_nodes {0};
+    std::mutex done_mutex;
+    std::condition_variable done_variable;
+
+    // Declared last, so the workers are stopped before anything they use is destroyed
+    jw_util::WorkQueue<num_threads, NodeId> queue;
+
+    void build()
+    {
+        for (Node &node : nodes)
+        {
+            node.num_predecessors = 0;
+            node.successors_begin = 0;
+            node.successors_end = 0;
+        }
+
+        // Counting sort of the edges by their source node
+        for (const std::pair<NodeId, NodeId> &edge : edges)
+        {
+            nodes[edge.first].successors_end++;
+            nodes[edge.second].num_predecessors++;
+        }
+
+        unsigned int offset = 0;
+        for (Node &node : nodes)
+        {
+            unsigned int count = node.successors_end;
+            node.successors_begin = offset;
+            node.successors_end = offset;
+            offset += count;
+        }
+
+        successors.resize(edges.size());
+        for (const std::pair<NodeId, NodeId> &edge : edges)
+        {
+            successors[nodes[edge.first].successors_end++] = edge.second;
+        }
+
+        roots.clear();
+        for (NodeId i = 0; i < nodes.size(); i++)
+        {
+            if (!nodes[i].num_predecessors)
+            {
+                roots.push_back(i);
+            }
+        }
+
+        pending_predecessors.reset(new std::atomic<unsigned int>[nodes.size()]);
+
+#ifndef NDEBUG
+        assert_acyclic();
+#endif
+
+        dirty = false;
+    }
+
+#ifndef NDEBUG
+    void assert_acyclic() const
+    {
+        std::vector<unsigned int> counts(nodes.size());
+        for (NodeId i = 0; i < nodes.size(); i++)
+        {
+            counts[i] = nodes[i].num_predecessors;
+        }
+
+        std::vector<NodeId> ready = roots;
+        unsigned int visited = 0;
+        while (!ready.empty())
+        {
+            NodeId id = ready.back();
+            ready.pop_back();
+            visited++;
+
+            for (unsigned int i = nodes[id].successors_begin; i < nodes[id].successors_end; i++)
+            {
+                if (!--counts[successors[i]])
+                {
+                    ready.push_back(successors[i]);
+                }
+            }
+        }
+
+        // Otherwise some nodes are in a cycle and run() would never return
+        assert(visited == nodes.size());
+    }
+#endif
+
+    void run_node(NodeId id)
+    {
+        while (true)
+        {
+            const Node &node = nodes[id];
+            node.callback.call();
+
+            NodeId next = static_cast<NodeId>(-1);
+            for (unsigned int i = node.successors_begin; i < node.successors_end; i++)
+            {
+                NodeId successor = successors[i];
+                if (pending_predecessors[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    if (next == static_cast<NodeId>(-1))
+                    {
+                        next = successor;
+                    }
+                    else
+                    {
+                        queue.push(successor);
+                    }
+                }
+            }
+
+            if (remaining_nodes.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    (void) lock;
+                }
+                done_variable.notify_all();
+            }
+
+            if (next == static_cast<NodeId>(-1)) {break;}
+            id = next;
+        }
+    }
+};
+
+}
+
+#endif // JWUTIL_TASKGRAPH_H
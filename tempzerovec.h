@@ -1,78 +1,122 @@
 #ifndef JWUTIL_TEMPZEROVEC_H
 #define JWUTIL_TEMPZEROVEC_H
 
+#include <assert.h>
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 namespace jw_util
 {
 
-template <typename DataType>
+// Zero-filled scratch space. Each thread has its own stack of frames, so it can be used from any thread, and alloc can be called again before free.
+// Frees have to come in the reverse order of allocs on each thread.
+// Without track_dirty, the caller guarantees the vec is all zeroes again when it's freed.
+// With track_dirty, every index written through the non-const operator[] is remembered as a range, and free zeroes just that range.
+
+template <typename DataType, bool track_dirty = false>
 class TempZeroVec
 {
 public:
     static TempZeroVec alloc(unsigned int size)
     {
-#ifdef TEMPZEROVEC_ASSERT_UNLOCKED
-        assert(!locked);
-        locked = true;
-#endif
+        State &state = get_state();
+
+        TempZeroVec res;
+        res.prev_buffer = state.top_buffer;
+        res.prev_offset = state.top_offset;
 
-        if (data.size() < size)
+        // Try buffers from the top up, then make a new one. Buffers are never freed, so frames never move.
+        while (state.top_buffer < state.buffers.size() && state.buffers[state.top_buffer].size - state.top_offset < size)
         {
-            data.resize(size, 0);
+            state.top_buffer++;
+            state.top_offset = 0;
+        }
+        if (state.top_buffer == state.buffers.size())
+        {
+            unsigned int buffer_size = state.buffers.empty() ? 1024 : state.buffers.back().size * 2;
+            Buffer buffer;
+            buffer.size = std::max(buffer_size, size);
+            buffer.data.reset(new DataType[buffer.size]());
+            state.buffers.push_back(std::move(buffer));
         }
 
-        return TempZeroVec();
+        res.data = state.buffers[state.top_buffer].data.get() + state.top_offset;
+        res.size = size;
+        state.top_offset += size;
+        return res;
     }
 
     static void free(const TempZeroVec &vec)
     {
-#ifdef TEMPZEROVEC_ASSERT_UNLOCKED
-        assert(locked);
-        locked = false;
-#endif
+        State &state = get_state();
+        assert(state.buffers[state.top_buffer].data.get() + state.top_offset == vec.data + vec.size);
+
+        if (track_dirty && vec.dirty_begin < vec.dirty_end)
+        {
+            std::fill(vec.data + vec.dirty_begin, vec.data + vec.dirty_end, static_cast<DataType>(0));
+        }
 
 #ifdef TEMPZEROVEC_ASSERT_ZEROED
-        typename std::vector<DataType>::const_iterator i = data.cbegin();
-        while (i != data.cend())
+        for (unsigned int i = 0; i < vec.size; i++)
         {
-            assert(*i == static_cast<DataType>(0));
-            i++;
+            assert(vec.data[i] == static_cast<DataType>(0));
         }
 #endif
+
+        state.top_buffer = vec.prev_buffer;
+        state.top_offset = vec.prev_offset;
     }
 
     DataType &operator[](unsigned int i)
     {
-        assert(i < data.size());
+        assert(i < size);
+        if (track_dirty)
+        {
+            dirty_begin = std::min(dirty_begin, i);
+            dirty_end = std::max(dirty_end, i + 1);
+        }
         return data[i];
     }
 
     const DataType &operator[](unsigned int i) const
     {
-        assert(i < data.size());
+        assert(i < size);
         return data[i];
     }
 
+    unsigned int get_size() const {return size;}
+
 private:
-    TempZeroVec()
+    TempZeroVec() {}
+
+    struct Buffer
     {
-    }
+        std::unique_ptr<DataType[]> data;
+        unsigned int size;
+    };
 
-    static std::vector<DataType> data;
+    struct State
+    {
+        std::vector<Buffer> buffers;
+        unsigned int top_buffer = 0;
+        unsigned int top_offset = 0;
+    };
 
-#ifdef TEMPZEROVEC_ASSERT_UNLOCKED
-    static bool locked;
-#endif
-};
+    static State &get_state()
+    {
+        thread_local State state;
+        return state;
+    }
 
-template <typename DataType>
-std::vector<DataType> TempZeroVec<DataType>::data;
+    DataType *data;
+    unsigned int size;
+    unsigned int prev_buffer;
+    unsigned int prev_offset;
 
-#ifdef TEMPZEROVEC_ASSERT_UNLOCKED
-template <typename DataType>
-bool TempZeroVec<DataType>::locked = false;
-#endif
+    unsigned int dirty_begin = static_cast<unsigned int>(-1);
+    unsigned int dirty_end = 0;
+};
 
 }
 
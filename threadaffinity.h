@@ -0,0 +1,164 @@
+#ifndef JWUTIL_THREADAFFINITY_H
+#define JWUTIL_THREADAFFINITY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace jw_util
+{
+
+// Pins threads to CPUs. Everything here is a no-op that returns false (or an empty list) on platforms other than Linux.
+
+class ThreadAffinity
+{
+public:
+    ThreadAffinity() = delete;
+
+    static bool set_current_thread_cpu(unsigned int cpu)
+    {
+#ifdef __linux__
+        if (cpu >= CPU_SETSIZE) {return false;}
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        (void) cpu;
+        return false;
+#endif
+    }
+
+    // The CPUs this process is allowed to run on, in ascending order
+    static std::vector<unsigned int> get_allowed_cpus()
+    {
+        std::vector<unsigned int> res;
+
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (unsigned int i = 0; i < CPU_SETSIZE; i++)
+            {
+                if (CPU_ISSET(i, &set))
+                {
+                    res.push_back(i);
+                }
+            }
+        }
+#endif
+
+        return res;
+    }
+
+    // The allowed CPUs, ordered so that pinning thread i to element i spreads threads as widely as possible:
+    // consecutive elements alternate between NUMA nodes, and every physical core is used once before any hyperthread sibling is.
+    static std::vector<unsigned int> get_spread_cpus()
+    {
+        std::vector<unsigned int> allowed = get_allowed_cpus();
+
+        // Rank 0 is the first logical CPU of each physical core, rank 1 its first sibling, and so on
+        std::vector<std::pair<unsigned int, unsigned int>> ranked;
+        for (unsigned int cpu : allowed)
+        {
+            std::vector<unsigned int> siblings = read_cpu_list("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+            unsigned int rank = std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin();
+            if (rank == siblings.size()) {rank = 0;}
+            ranked.emplace_back(rank, cpu);
+        }
+        std::stable_sort(ranked.begin(), ranked.end());
+
+        std::vector<std::vector<unsigned int>> nodes;
+        for (unsigned int node = 0; ; node++)
+        {
+            std::vector<unsigned int> node_cpus = read_cpu_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (node_cpus.empty()) {break;}
+
+            std::vector<unsigned int> ordered;
+            for (const std::pair<unsigned int, unsigned int> &entry : ranked)
+            {
+                if (std::find(node_cpus.begin(), node_cpus.end(), entry.second) != node_cpus.end())
+                {
+                    ordered.push_back(entry.second);
+                }
+            }
+
+            if (!ordered.empty())
+            {
+                nodes.push_back(std::move(ordered));
+            }
+        }
+
+        if (nodes.empty())
+        {
+            // No NUMA information, treat the machine as one node
+            std::vector<unsigned int> ordered;
+            for (const std::pair<unsigned int, unsigned int> &entry : ranked)
+            {
+                ordered.push_back(entry.second);
+            }
+            return ordered;
+        }
+
+        std::vector<unsigned int> res;
+        for (unsigned int i = 0; res.size() < allowed.size(); i++)
+        {
+            bool any = false;
+            for (const std::vector<unsigned int> &node_cpus : nodes)
+            {
+                if (i < node_cpus.size())
+                {
+                    res.push_back(node_cpus[i]);
+                    any = true;
+                }
+            }
+            if (!any) {break;}
+        }
+        return res;
+    }
+
+private:
+    // Parses the kernel's cpu list format, like "0-3,8,10-11"
+    static std::vector<unsigned int> read_cpu_list(const std::string &path)
+    {
+        std::vector<unsigned int> res;
+
+        std::ifstream file(path);
+        std::string list;
+        if (!std::getline(file, list)) {return res;}
+
+        std::string::size_type pos = 0;
+        while (pos < list.size())
+        {
+            std::string::size_type end = list.find(',', pos);
+            if (end == std::string::npos) {end = list.size();}
+
+            std::string range = list.substr(pos, end - pos);
+            std::string::size_type dash = range.find('-');
+            if (!range.empty())
+            {
+                unsigned int first = std::stoul(range.substr(0, dash));
+                unsigned int last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+                for (unsigned int i = first; i <= last; i++)
+                {
+                    res.push_back(i);
+                }
+            }
+
+            pos = end + 1;
+        }
+
+        return res;
+    }
+};
+
+}
+
+#endif // JWUTIL_THREADAFFINITY_H
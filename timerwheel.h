@@ -0,0 +1,328 @@
+#ifndef JWUTIL_TIMERWHEEL_H
+#define JWUTIL_TIMERWHEEL_H
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "methodcallback.h"
+
+namespace jw_util
+{
+
+// Hierarchical timer wheel holding one-shot and periodic callbacks, with O(1) add and cancel.
+// Time is divided into ticks; each level has 64 slots, and a slot in level L spans 64^L ticks.
+// Timers are moved down a level when the wheel reaches their slot, and fire when advance() passes their tick, so they're never early but can be up to a tick late.
+// Not thread-safe: the owner has to lock around it.
+
+class TimerWheel
+{
+    struct Node;
+
+public:
+    // Stays valid for a periodic timer until it's cancelled, and for a one-shot timer until it fires
+    struct TimerId
+    {
+        Node *node = 0;
+        std::uint64_t serial = 0;
+    };
+
+    TimerWheel(std::chrono::steady_clock::duration init_tick = std::chrono::milliseconds(1))
+        : tick(init_tick)
+        , origin(std::chrono::steady_clock::now())
+    {
+        assert(tick > std::chrono::steady_clock::duration::zero());
+
+        for (unsigned int level = 0; level < num_levels; level++)
+        {
+            occupied[level] = 0;
+            for (unsigned int slot = 0; slot < num_slots; slot++)
+            {
+                slots[level][slot] = 0;
+            }
+        }
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // Fires at when, and then every period after that if period isn't zero
+    TimerId add(std::chrono::steady_clock::time_point when, jw_util::MethodCallback<> callback, std::chrono::steady_clock::duration period = std::chrono::steady_clock::duration::zero())
+    {
+        assert(callback.is_valid());
+        assert(period >= std::chrono::steady_clock::duration::zero());
+
+        Node *node;
+        if (free_nodes.empty())
+        {
+            nodes.emplace_back();
+            node = &nodes.back();
+        }
+        else
+        {
+            node = free_nodes.back();
+            free_nodes.pop_back();
+        }
+
+        node->serial = ++next_serial;
+        node->callback = callback;
+        node->period_ticks = 0;
+        if (period != std::chrono::steady_clock::duration::zero())
+        {
+            node->period_ticks = std::max<std::uint64_t>(to_ticks_ceil(period), 1);
+        }
+
+        // The current tick has already been processed
+        node->expiry_tick = std::max(to_ticks_ceil(when - origin), current_tick + 1);
+
+        insert(node);
+        num_timers++;
+
+        TimerId id;
+        id.node = node;
+        id.serial = node->serial;
+        return id;
+    }
+
+    // Returns false if the timer already fired (for a one-shot timer) or was already cancelled
+    bool cancel(TimerId id)
+    {
+        if (!id.node || id.node->serial != id.serial) {return false;}
+
+        unlink(id.node);
+        release(id.node);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return !num_timers;
+    }
+
+    std::size_t size() const
+    {
+        return num_timers;
+    }
+
+    // When advance() next has work to do, or time_point::max() if there are no timers.
+    // For timers far in the future this is when they move down a level, so calling advance() then might not fire anything.
+    std::chrono::steady_clock::time_point get_next_expiry() const
+    {
+        if (!num_timers) {return std::chrono::steady_clock::time_point::max();}
+        return origin + tick * get_next_event_tick();
+    }
+
+    // Appends the callbacks of every timer due by now to due, in expiry order, and reschedules the periodic ones.
+    // A periodic timer fires at most once per call, even if several of its periods have passed.
+    // The callbacks aren't called here, so the caller can release its lock first.
+    void advance(std::chrono::steady_clock::time_point now, std::vector<jw_util::MethodCallback<>> &due)
+    {
+        std::uint64_t target_tick = now > origin ? to_ticks_floor(now - origin) : 0;
+
+        while (current_tick < target_tick)
+        {
+            if (!num_timers)
+            {
+                current_tick = target_tick;
+                break;
+            }
+
+            // Skip straight to the next tick that has something to cascade or fire
+            std::uint64_t next_tick = get_next_event_tick();
+            if (next_tick > target_tick)
+            {
+                current_tick = target_tick;
+                break;
+            }
+
+            current_tick = next_tick;
+            process_tick(target_tick, due);
+        }
+    }
+
+private:
+    static constexpr unsigned int level_bits = 6;
+    static constexpr unsigned int num_slots = 1u << level_bits;
+    static constexpr unsigned int num_levels = 6;
+
+    // Timers further out than this are parked in the last level and cascaded again when they reach the bottom
+    static constexpr std::uint64_t max_delta = (static_cast<std::uint64_t>(1) << (level_bits * num_levels)) - 1;
+
+    struct Node
+    {
+        Node *next;
+        Node **prev_next = 0;
+        unsigned int level;
+        unsigned int slot;
+
+        std::uint64_t serial = 0;
+        std::uint64_t expiry_tick;
+        std::uint64_t period_ticks;
+        jw_util::MethodCallback<> callback;
+    };
+
+    std::chrono::steady_clock::duration tick;
+    std::chrono::steady_clock::time_point origin;
+    std::uint64_t current_tick = 0;
+
+    Node *slots[num_levels][num_slots];
+    std::uint64_t occupied[num_levels];
+    std::size_t num_timers = 0;
+
+    // Nodes are never given back, so TimerIds can always be checked against their serial
+    std::deque<Node> nodes;
+    std::vector<Node *> free_nodes;
+    std::uint64_t next_serial = 0;
+
+    std::uint64_t to_ticks_floor(std::chrono::steady_clock::duration duration) const
+    {
+        return duration / tick;
+    }
+
+    std::uint64_t to_ticks_ceil(std::chrono::steady_clock::duration duration) const
+    {
+        if (duration <= std::chrono::steady_clock::duration::zero()) {return 0;}
+        return duration / tick + (duration % tick != std::chrono::steady_clock::duration::zero());
+    }
+
+    void insert(Node *node)
+    {
+        std::uint64_t place_tick = node->expiry_tick;
+        if (place_tick - current_tick > max_delta)
+        {
+            place_tick = current_tick + max_delta;
+        }
+
+        std::uint64_t delta = place_tick - current_tick;
+        unsigned int level = 0;
+        while (delta >> (level_bits * (level + 1)))
+        {
+            level++;
+        }
+
+        unsigned int slot = (place_tick >> (level_bits * level)) & (num_slots - 1);
+        node->level = level;
+        node->slot = slot;
+
+        Node **head = &slots[level][slot];
+        node->next = *head;
+        node->prev_next = head;
+        if (node->next)
+        {
+            node->next->prev_next = &node->next;
+        }
+        *head = node;
+
+        occupied[level] |= static_cast<std::uint64_t>(1) << slot;
+    }
+
+    void unlink(Node *node)
+    {
+        *node->prev_next = node->next;
+        if (node->next)
+        {
+            node->next->prev_next = node->prev_next;
+        }
+        node->prev_next = 0;
+
+        if (!slots[node->level][node->slot])
+        {
+            occupied[node->level] &= ~(static_cast<std::uint64_t>(1) << node->slot);
+        }
+    }
+
+    void release(Node *node)
+    {
+        node->serial = 0;
+        free_nodes.push_back(node);
+        num_timers--;
+    }
+
+    // Detaches the whole list in a slot
+    Node *take_slot(unsigned int level, unsigned int slot)
+    {
+        Node *list = slots[level][slot];
+        slots[level][slot] = 0;
+        occupied[level] &= ~(static_cast<std::uint64_t>(1) << slot);
+        return list;
+    }
+
+    std::uint64_t get_next_event_tick() const
+    {
+        std::uint64_t res = static_cast<std::uint64_t>(-1);
+
+        for (unsigned int level = 0; level < num_levels; level++)
+        {
+            if (!occupied[level]) {continue;}
+
+            // Distance (1 to num_slots) from the current slot to the next occupied one, going around the wheel
+            std::uint64_t base = current_tick >> (level_bits * level);
+            unsigned int rotate = (base + 1) & (num_slots - 1);
+            std::uint64_t rotated = rotate ? (occupied[level] >> rotate) | (occupied[level] << (num_slots - rotate)) : occupied[level];
+            std::uint64_t distance = __builtin_ctzll(rotated) + 1;
+
+            std::uint64_t event_tick = (base + distance) << (level_bits * level);
+            if (event_tick < res)
+            {
+                res = event_tick;
+            }
+        }
+
+        return res;
+    }
+
+    void process_tick(std::uint64_t target_tick, std::vector<jw_util::MethodCallback<>> &due)
+    {
+        // Move timers down from every level whose slot boundary we just crossed
+        for (unsigned int level = 1; level < num_levels; level++)
+        {
+            if (current_tick & ((static_cast<std::uint64_t>(1) << (level_bits * level)) - 1)) {break;}
+
+            Node *node = take_slot(level, (current_tick >> (level_bits * level)) & (num_slots - 1));
+            while (node)
+            {
+                Node *next = node->next;
+                insert(node);
+                node = next;
+            }
+        }
+
+        Node *node = take_slot(0, current_tick & (num_slots - 1));
+        while (node)
+        {
+            Node *next = node->next;
+
+            if (node->expiry_tick > current_tick)
+            {
+                // Was parked past max_delta
+                insert(node);
+            }
+            else
+            {
+                due.push_back(node->callback);
+
+                if (node->period_ticks)
+                {
+                    // Periods that were missed entirely are skipped rather than fired back-to-back, keeping the original phase
+                    std::uint64_t behind = target_tick - node->expiry_tick;
+                    node->expiry_tick += (behind / node->period_ticks + 1) * node->period_ticks;
+                    insert(node);
+                }
+                else
+                {
+                    node->prev_next = 0;
+                    release(node);
+                }
+            }
+
+            node = next;
+        }
+    }
+};
+
+}
+
+#endif // JWUTIL_TIMERWHEEL_H
@@ -7,9 +7,9 @@ namespace jw_util
 {
 
 template <unsigned int num_threads, typename... ArgTypes>
-class WorkQueue : public WorkQueueBase<WorkQueue<num_threads, ArgTypes...>, num_threads, ArgTypes...>
+class WorkQueue : public WorkQueueBase<WorkQueue<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, ArgTypes...>
 {
-    typedef WorkQueueBase<WorkQueue<num_threads, ArgTypes...>, num_threads, ArgTypes...> BaseType;
+    typedef WorkQueueBase<WorkQueue<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, ArgTypes...> BaseType;
     friend BaseType;
 
 public:
@@ -1,27 +1,72 @@
 #ifndef JWUTIL_WORKQUEUEBASE_H
 #define JWUTIL_WORKQUEUEBASE_H
 
-#include <array>
 #include <tuple>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 #include "methodcallback.h"
+#include "threadaffinity.h"
 
 namespace jw_util
 {
 
-template <typename Derived, unsigned int num_threads, typename... ArgTypes>
+// Default task storage: a plain FIFO, only ever touched while holding WorkQueueBase::mutex
+
+template <typename TaskType>
+class WorkQueueStorageFifo : public std::queue<TaskType>
+{
+public:
+    static constexpr bool is_lock_free = false;
+};
+
+// Default telemetry: records nothing, and queues the bare TupleType so it costs nothing
+
+struct WorkQueueTelemetryNone
+{
+    static constexpr bool enabled = false;
+
+    template <typename TupleType>
+    using Task = TupleType;
+
+    void on_push(unsigned int count) {(void) count;}
+    void on_pop() {}
+};
+
+// Compile-time policies for WorkQueueBase. Derive from this and override members to change them.
+// Storage must either have is_lock_free = false and provide empty/size/front/pop/emplace (like std::queue),
+// or have is_lock_free = true and provide empty/size/try_pop/try_emplace (like RingMPMC).
+// Telemetry chooses what's stored alongside each task, and gets told about every push, pop and dispatch (see WorkQueueTelemetryHistogram).
+
+struct WorkQueueTraits
+{
+    template <typename TaskType>
+    using Storage = WorkQueueStorageFifo<TaskType>;
+
+    typedef WorkQueueTelemetryNone Telemetry;
+};
+
+// Pass as num_threads to choose the number of workers at runtime instead, and be able to change it with set_num_threads() or set_elastic()
+static constexpr unsigned int work_queue_dynamic_threads = static_cast<unsigned int>(-1);
+
+template <typename Derived, unsigned int num_threads, typename Traits, typename... ArgTypes>
 class WorkQueueBase
 {
 public:
     struct construct_paused_t {};
     static constexpr construct_paused_t construct_paused {};
 
+    typedef std::tuple<typename std::remove_reference<ArgTypes>::type...> TupleType;
+
     WorkQueueBase(jw_util::MethodCallback<ArgTypes...> worker)
         : worker(worker)
+        , target_threads(get_default_num_threads())
         , running(false)
     {
         start();
@@ -29,9 +74,29 @@ public:
 
     WorkQueueBase(jw_util::MethodCallback<ArgTypes...> worker, construct_paused_t)
         : worker(worker)
+        , target_threads(get_default_num_threads())
         , running(false)
     {}
 
+    WorkQueueBase(jw_util::MethodCallback<ArgTypes...> worker, unsigned int init_num_threads)
+        : worker(worker)
+        , target_threads(init_num_threads)
+        , running(false)
+    {
+        static_assert(num_threads == work_queue_dynamic_threads, "WorkQueueBase: Can only pass a thread count if num_threads is work_queue_dynamic_threads");
+        assert(init_num_threads);
+        start();
+    }
+
+    WorkQueueBase(jw_util::MethodCallback<ArgTypes...> worker, unsigned int init_num_threads, construct_paused_t)
+        : worker(worker)
+        , target_threads(init_num_threads)
+        , running(false)
+    {
+        static_assert(num_threads == work_queue_dynamic_threads, "WorkQueueBase: Can only pass a thread count if num_threads is work_queue_dynamic_threads");
+        assert(init_num_threads);
+    }
+
     ~WorkQueueBase()
     {
         if (running)
@@ -46,87 +111,726 @@ public:
 
         if (num_threads)
         {
+            push_task(std::forward<ArgTypes>(args)...);
+        }
+        else
+        {
+            worker.call(std::forward<ArgTypes>(args)...);
+        }
+    }
+
+    // Pushes every TupleType in [begin, end) with one lock acquisition, then wakes up to one worker per task
+    template <typename IteratorType>
+    void push_batch(IteratorType begin, IteratorType end)
+    {
+        assert(running);
+
+        if (begin == end) {return;}
+
+        if (num_threads)
+        {
+            unsigned int count = 0;
+
+            if constexpr (StorageType::is_lock_free)
             {
-                std::lock_guard<std::mutex> lock(mutex);
-                (void) lock;
-                queue.emplace(std::forward<ArgTypes>(args)...);
+                while (begin != end)
+                {
+                    telemetry.on_push(1);
+                    if (!queue.try_emplace(*begin))
+                    {
+                        push_full(*begin);
+                    }
+                    begin++;
+                    count++;
+                }
+
+                wake_sleepers(count);
+            }
+            else
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    (void) lock;
+                    while (begin != end)
+                    {
+                        queue.emplace(*begin);
+                        begin++;
+                        count++;
+                    }
+                    telemetry.on_push(count);
+                }
+
+                if (count >= get_num_threads())
+                {
+                    get_derived()->notify_all();
+                }
+                else
+                {
+                    while (count--)
+                    {
+                        get_derived()->notify_one();
+                    }
+                }
             }
-            conditional_variable.notify_one();
         }
         else
         {
-            worker.call(std::forward<ArgTypes>(args)...);
+            while (begin != end)
+            {
+                dispatch(TupleType(*begin));
+                begin++;
+            }
         }
     }
 
+    // Lets each worker take up to batch_size tasks per lock acquisition, and run them back-to-back.
+    // Has no effect with lock-free storage, where popping doesn't lock anyway.
+    void set_batch_size(unsigned int new_batch_size)
+    {
+        assert(new_batch_size >= 1);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        (void) lock;
+        batch_size = new_batch_size;
+    }
+
+    // Pins worker i to cpus[i % cpus.size()] the next time the workers are started. An empty list leaves them unpinned.
+    void set_thread_cpus(std::vector<unsigned int> cpus)
+    {
+        assert(!running);
+        thread_cpus = std::move(cpus);
+    }
+
+    // Spreads the workers across NUMA nodes and physical cores
+    void set_thread_cpus_spread()
+    {
+        set_thread_cpus(jw_util::ThreadAffinity::get_spread_cpus());
+    }
+
+    // Called on each worker thread with its index, after pinning and before it takes any tasks, e.g. for first-touch allocation
+    void set_thread_init(jw_util::MethodCallback<unsigned int> init)
+    {
+        assert(!running);
+        thread_init = init;
+    }
+
+    const typename Traits::Telemetry &get_telemetry() const
+    {
+        return telemetry;
+    }
+
+    unsigned int get_num_threads() const
+    {
+        if constexpr (num_threads == work_queue_dynamic_threads)
+        {
+            return running.load(std::memory_order_relaxed) ? thread_count.load(std::memory_order_relaxed) : target_threads;
+        }
+        else
+        {
+            return num_threads;
+        }
+    }
+
+    // Spawns or retires workers until there are new_num_threads of them. Retired workers finish their current task first.
+    void set_num_threads(unsigned int new_num_threads)
+    {
+        static_assert(num_threads == work_queue_dynamic_threads, "WorkQueueBase: Can only change the thread count if num_threads is work_queue_dynamic_threads");
+        assert(new_num_threads);
+
+        std::lock_guard<std::mutex> threads_lock(threads_mutex);
+        (void) threads_lock;
+
+        target_threads = new_num_threads;
+        if (!running) {return;}
+
+        resize_threads(new_num_threads);
+    }
+
+    // Lets the queue size itself between min_threads and max_threads:
+    // a push that finds no idle worker and at least grow_queue_depth queued tasks spawns a worker,
+    // and Derived::wait can call retire_idle_thread() after a worker has been idle for idle_timeout.
+    // Call this before pushing from other threads, since push reads these settings without locking.
+    template <typename DurationRep, typename DurationPeriod>
+    void set_elastic(unsigned int min_threads, unsigned int max_threads, unsigned int grow_queue_depth, std::chrono::duration<DurationRep, DurationPeriod> idle_timeout)
+    {
+        static_assert(num_threads == work_queue_dynamic_threads, "WorkQueueBase: Can only be elastic if num_threads is work_queue_dynamic_threads");
+        assert(min_threads);
+        assert(min_threads <= max_threads);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        (void) lock;
+        elastic_min_threads = min_threads;
+        elastic_max_threads = max_threads;
+        elastic_grow_queue_depth = grow_queue_depth;
+        elastic_idle_timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(idle_timeout);
+        elastic.store(true, std::memory_order_relaxed);
+    }
+
     void start()
     {
         assert(!running);
 
         running = true;
+        cancelled.store(false, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> threads_lock(threads_mutex);
+        (void) threads_lock;
 
-        for (unsigned int i = 0; i < num_threads; i++)
+        next_thread_index = 0;
+        for (unsigned int i = 0; i < target_threads; i++)
         {
-            threads[i] = std::thread(&WorkQueueBase<Derived, num_threads, ArgTypes...>::loop, this);
+            spawn_thread();
         }
     }
 
+    // Stops the workers once they've run everything that's been pushed
     void pause()
     {
         assert(running);
 
+        stop_running();
+        join_threads();
+    }
+
+    // Like pause(), but the workers stop taking tasks at the deadline, and is_cancelled() starts returning true so long-running tasks can bail out.
+    // Returns the tasks that never ran, in no particular order.
+    std::vector<TupleType> pause_until(std::chrono::steady_clock::time_point deadline)
+    {
+        assert(running);
+
+        stop_running();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!drained_variable.wait_until(lock, deadline, [this]() {return !live_threads.load(std::memory_order_relaxed);}))
+            {
+                cancelled.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        join_threads();
+        return take_remaining();
+    }
+
+    // Cancels immediately: workers finish (or bail out of) their current task, and everything still queued is destroyed. Returns how many tasks were dropped.
+    std::size_t pause_drop()
+    {
+        return pause_until(std::chrono::steady_clock::time_point::min()).size();
+    }
+
+    // For tasks to poll, so they can return early when pause_until() runs past its deadline, or pause_drop() is called
+    bool is_cancelled() const
+    {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+
+protected:
+    typedef typename Traits::Telemetry TelemetryType;
+    typedef typename TelemetryType::template Task<TupleType> TaskType;
+    typedef typename Traits::template Storage<TaskType> StorageType;
+
+    const jw_util::MethodCallback<ArgTypes...> worker;
+
+    // Guarded by threads_mutex. When both are needed, threads_mutex is locked before mutex.
+    std::mutex threads_mutex;
+    std::vector<std::thread> threads;
+    std::vector<std::thread> exited_threads;
+    unsigned int target_threads;
+    unsigned int next_thread_index = 0;
+
+    // Number of workers, not counting ones that have been told to retire
+    std::atomic<unsigned int> thread_count {0};
+
+    // Number of worker threads that haven't returned yet, including retired ones. Decremented holding mutex.
+    std::atomic<unsigned int> live_threads {0};
+    std::condition_variable drained_variable;
+
+    // Set when a pause passes its deadline. Workers stop taking tasks, and ones they'd already taken end up in leftover_tasks.
+    std::atomic<bool> cancelled {false};
+    std::vector<TaskType> leftover_tasks;
+
+    std::mutex mutex;
+    std::condition_variable conditional_variable;
+
+    StorageType queue;
+
+    TelemetryType telemetry;
+
+    // Atomic since maybe_grow and get_num_threads read it without holding mutex
+    std::atomic<bool> running;
+
+    unsigned int batch_size = 1;
+
+    std::vector<unsigned int> thread_cpus;
+    jw_util::MethodCallback<unsigned int> thread_init;
+
+    // Workers that are about to wait(), or are waiting
+    std::atomic<unsigned int> sleeping {0};
+
+    // Only used by lock-free storage: pushers blocked on a full queue
+    std::atomic<unsigned int> full_waiters {0};
+    std::condition_variable not_full_variable;
+
+    // Number of idle workers that should exit instead of waiting
+    unsigned int threads_to_retire = 0;
+
+    std::atomic<bool> elastic {false};
+    unsigned int elastic_min_threads = 1;
+    unsigned int elastic_max_threads = 1;
+    unsigned int elastic_grow_queue_depth = 0;
+    std::chrono::steady_clock::duration elastic_idle_timeout = std::chrono::steady_clock::duration::max();
+
+    static unsigned int get_default_num_threads()
+    {
+        if constexpr (num_threads == work_queue_dynamic_threads)
+        {
+            unsigned int hardware_threads = std::thread::hardware_concurrency();
+            return hardware_threads ? hardware_threads : 1;
+        }
+        else
+        {
+            return num_threads;
+        }
+    }
+
+    void stop_running()
+    {
         {
             std::lock_guard<std::mutex> lock(mutex);
             (void) lock;
             running = false;
+            threads_to_retire = 0;
         }
 
-        conditional_variable.notify_all();
+        get_derived()->notify_all();
+    }
+
+    void join_threads()
+    {
+        // Can't join while holding threads_mutex, since a retiring worker might be waiting on it to remove itself
+        std::vector<std::thread> joining;
+        {
+            std::lock_guard<std::mutex> threads_lock(threads_mutex);
+            (void) threads_lock;
+
+            joining.swap(threads);
+            for (std::thread &thread : exited_threads)
+            {
+                joining.push_back(std::move(thread));
+            }
+            exited_threads.clear();
+
+            if constexpr (num_threads == work_queue_dynamic_threads)
+            {
+                target_threads = thread_count.load(std::memory_order_relaxed);
+            }
+            thread_count.store(0, std::memory_order_relaxed);
+        }
 
-        for (unsigned int i = 0; i < num_threads; i++)
+        for (std::thread &thread : joining)
         {
-            threads[i].join();
+            thread.join();
         }
     }
 
-protected:
-    typedef std::tuple<typename std::remove_reference<ArgTypes>::type...> TupleType;
+    // Must hold threads_mutex
+    void spawn_thread()
+    {
+        threads.emplace_back(&WorkQueueBase<Derived, num_threads, Traits, ArgTypes...>::loop, this, next_thread_index++);
+        thread_count.fetch_add(1, std::memory_order_relaxed);
+        live_threads.fetch_add(1, std::memory_order_relaxed);
+    }
 
-    const jw_util::MethodCallback<ArgTypes...> worker;
+    // Must hold threads_mutex
+    void resize_threads(unsigned int new_count)
+    {
+        for (std::thread &thread : exited_threads)
+        {
+            thread.join();
+        }
+        exited_threads.clear();
 
-    std::array<std::thread, num_threads> threads;
+        unsigned int cur_count = thread_count.load(std::memory_order_relaxed);
+        if (new_count > cur_count)
+        {
+            unsigned int spawn_count = new_count - cur_count;
+            {
+                // Workers that were told to retire but haven't noticed yet can just stay
+                std::lock_guard<std::mutex> lock(mutex);
+                (void) lock;
+                unsigned int keep_count = std::min(threads_to_retire, spawn_count);
+                threads_to_retire -= keep_count;
+                spawn_count -= keep_count;
+                thread_count.fetch_add(keep_count, std::memory_order_relaxed);
+            }
 
-    std::mutex mutex;
-    std::condition_variable conditional_variable;
+            while (spawn_count--)
+            {
+                spawn_thread();
+            }
+        }
+        else if (new_count < cur_count)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                (void) lock;
+                threads_to_retire += cur_count - new_count;
+                thread_count.store(new_count, std::memory_order_relaxed);
+            }
+
+            get_derived()->notify_all();
+        }
+    }
+
+    void maybe_grow(std::size_t depth)
+    {
+        if (!elastic.load(std::memory_order_relaxed)) {return;}
+        if (sleeping.load(std::memory_order_relaxed)) {return;}
+        if (depth < elastic_grow_queue_depth) {return;}
+        if (thread_count.load(std::memory_order_relaxed) >= elastic_max_threads) {return;}
+
+        // If someone else is already resizing, let them
+        std::unique_lock<std::mutex> threads_lock(threads_mutex, std::try_to_lock);
+        if (!threads_lock.owns_lock() || !running.load(std::memory_order_relaxed)) {return;}
+
+        unsigned int cur_count = thread_count.load(std::memory_order_relaxed);
+        if (cur_count < elastic_max_threads)
+        {
+            resize_threads(cur_count + 1);
+        }
+    }
+
+    // For Derived::wait to call (holding mutex) when a worker has been idle for a while. Returns true if some idle worker will exit.
+    bool retire_idle_thread()
+    {
+        if (!elastic.load(std::memory_order_relaxed)) {return false;}
 
-    std::queue<TupleType> queue;
+        unsigned int cur_count = thread_count.load(std::memory_order_relaxed);
+        if (cur_count <= elastic_min_threads) {return false;}
 
-    bool running;
+        threads_to_retire++;
+        thread_count.store(cur_count - 1, std::memory_order_relaxed);
+        return true;
+    }
 
-    void loop()
+    // Called by a worker that's exiting while the queue is still running
+    void remove_retired_thread()
+    {
+        std::lock_guard<std::mutex> threads_lock(threads_mutex);
+        (void) threads_lock;
+
+        std::thread::id id = std::this_thread::get_id();
+        for (std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); i++)
+        {
+            if (i->get_id() == id)
+            {
+                exited_threads.push_back(std::move(*i));
+                threads.erase(i);
+                break;
+            }
+        }
+
+        // If it wasn't found, pause() has already taken it and will join it
+    }
+
+    void loop(unsigned int thread_index)
     {
         assert(num_threads);
 
+        if (!thread_cpus.empty())
+        {
+            jw_util::ThreadAffinity::set_current_thread_cpu(thread_cpus[thread_index % thread_cpus.size()]);
+        }
+
+        get_derived()->on_thread_start(thread_index);
+
+        if (thread_init.is_valid())
+        {
+            thread_init.call(thread_index);
+        }
+
+        bool retired;
+        if constexpr (StorageType::is_lock_free)
+        {
+            retired = loop_lock_free(thread_index);
+        }
+        else
+        {
+            retired = loop_locked(thread_index);
+        }
+
+        if (retired)
+        {
+            remove_retired_thread();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            (void) lock;
+            live_threads.fetch_sub(1, std::memory_order_relaxed);
+        }
+        drained_variable.notify_all();
+    }
+
+    // Empties the queue once every worker has exited
+    std::vector<TupleType> take_remaining()
+    {
+        std::vector<TupleType> res;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        (void) lock;
+
+        for (TaskType &task : leftover_tasks)
+        {
+            res.push_back(std::move(get_args(task)));
+        }
+        leftover_tasks.clear();
+
+        if constexpr (StorageType::is_lock_free)
+        {
+            TaskType task;
+            while (queue.try_pop(task))
+            {
+                telemetry.on_pop();
+                res.push_back(std::move(get_args(task)));
+            }
+        }
+        else
+        {
+            while (!queue.empty())
+            {
+                res.push_back(std::move(get_args(queue.front())));
+                queue.pop();
+                telemetry.on_pop();
+            }
+        }
+
+        return res;
+    }
+
+    // Returns true if the worker exited because it was retired, rather than because the queue was paused
+    bool loop_locked(unsigned int thread_index)
+    {
+        std::vector<TaskType> batch;
+
         std::unique_lock<std::mutex> lock(mutex);
         while (true)
         {
+            if (cancelled.load(std::memory_order_relaxed)) {return false;}
+
             if (queue.empty())
             {
-                if (!running) {break;}
+                if (!running) {return false;}
+                if (threads_to_retire)
+                {
+                    threads_to_retire--;
+                    return true;
+                }
+
+                sleeping.fetch_add(1, std::memory_order_relaxed);
                 get_derived()->wait(lock);
+                sleeping.fetch_sub(1, std::memory_order_relaxed);
+            }
+            else if (batch_size > 1)
+            {
+                do
+                {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop();
+                    telemetry.on_pop();
+                } while (!queue.empty() && batch.size() < batch_size);
+
+                lock.unlock();
+                typename std::vector<TaskType>::iterator i = batch.begin();
+                while (i != batch.end() && !cancelled.load(std::memory_order_relaxed))
+                {
+                    run_task(std::move(*i), thread_index);
+                    i++;
+                }
+                lock.lock();
+
+                while (i != batch.end())
+                {
+                    leftover_tasks.push_back(std::move(*i));
+                    i++;
+                }
+                batch.clear();
             }
             else
             {
-                TupleType args = std::move(queue.front());
+                TaskType task = std::move(queue.front());
                 queue.pop();
+                telemetry.on_pop();
 
                 lock.unlock();
-                dispatch(std::move(args));
+                run_task(std::move(task), thread_index);
                 lock.lock();
             }
         }
     }
 
+    bool loop_lock_free(unsigned int thread_index)
+    {
+        TaskType task;
+        while (true)
+        {
+            if (cancelled.load(std::memory_order_relaxed)) {return false;}
+
+            if (queue.try_pop(task))
+            {
+                telemetry.on_pop();
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (full_waiters.load(std::memory_order_relaxed))
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        (void) lock;
+                    }
+                    not_full_variable.notify_all();
+                }
+
+                run_task(std::move(task), thread_index);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (queue.empty())
+            {
+                if (!running || threads_to_retire)
+                {
+                    sleeping.fetch_sub(1, std::memory_order_relaxed);
+
+                    if (!running) {return false;}
+                    threads_to_retire--;
+                    return true;
+                }
+                get_derived()->wait(lock);
+            }
+
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds one task to the queue and wakes a worker. Takes whatever StorageType's emplace (or try_emplace) does, so derived queues can pass extra arguments.
+    template <typename... EmplaceArgTypes>
+    void push_task(EmplaceArgTypes &&... args)
+    {
+        if constexpr (StorageType::is_lock_free)
+        {
+            telemetry.on_push(1);
+            if (!queue.try_emplace(std::forward<EmplaceArgTypes>(args)...))
+            {
+                push_full(std::forward<EmplaceArgTypes>(args)...);
+            }
+
+            wake_sleepers(1);
+
+            if constexpr (num_threads == work_queue_dynamic_threads)
+            {
+                maybe_grow(queue.size());
+            }
+        }
+        else
+        {
+            std::size_t depth;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                (void) lock;
+                queue.emplace(std::forward<EmplaceArgTypes>(args)...);
+                depth = queue.size();
+                telemetry.on_push(1);
+            }
+            get_derived()->notify_one();
+
+            if constexpr (num_threads == work_queue_dynamic_threads)
+            {
+                maybe_grow(depth);
+            }
+        }
+    }
+
+    template <typename... EmplaceArgTypes>
+    void push_full(EmplaceArgTypes &&... args)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        full_waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        while (!queue.try_emplace(std::forward<EmplaceArgTypes>(args)...))
+        {
+            // The workers might not have been woken for what's already in the ring yet (e.g. in the middle of push_batch)
+            if (sleeping.load(std::memory_order_relaxed))
+            {
+                lock.unlock();
+                get_derived()->notify_all();
+                lock.lock();
+                continue;
+            }
+
+            not_full_variable.wait(lock);
+        }
+
+        full_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake_sleepers(unsigned int count)
+    {
+        // Pairs with the fence in loop_lock_free, so either we see the sleeper or it sees our tasks
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        unsigned int num_sleeping = sleeping.load(std::memory_order_relaxed);
+        if (!num_sleeping) {return;}
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            (void) lock;
+        }
+
+        if (count >= num_sleeping)
+        {
+            get_derived()->notify_all();
+        }
+        else
+        {
+            while (count--)
+            {
+                get_derived()->notify_one();
+            }
+        }
+    }
+
+    static TupleType &get_args(TaskType &task)
+    {
+        if constexpr (TelemetryType::enabled)
+        {
+            return task.args;
+        }
+        else
+        {
+            return task;
+        }
+    }
+
+    void run_task(TaskType &&task, unsigned int thread_index)
+    {
+        if constexpr (TelemetryType::enabled)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            dispatch(std::move(task.args));
+            std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+
+            telemetry.on_dispatch(thread_index, start - task.enqueue_time, finish - start);
+        }
+        else
+        {
+            (void) thread_index;
+            dispatch(std::move(task));
+        }
+    }
+
     void dispatch(TupleType &&args)
     {
         call(std::forward<TupleType>(args), std::index_sequence_for<ArgTypes...>{});
@@ -138,6 +842,23 @@ protected:
         worker.call(std::forward<ArgTypes>(std::get<Indices>(std::forward<TupleType>(args)))...);
     }
 
+    // Called on each worker thread with its index, before it takes any tasks. Derived classes can hide this to set up per-worker state.
+    void on_thread_start(unsigned int thread_index)
+    {
+        (void) thread_index;
+    }
+
+    // Derived classes can hide these to change how waiting workers are woken up. They're never called while holding the mutex.
+    void notify_one()
+    {
+        conditional_variable.notify_one();
+    }
+
+    void notify_all()
+    {
+        conditional_variable.notify_all();
+    }
+
     Derived *get_derived()
     {
         return static_cast<Derived *>(this);
@@ -0,0 +1,169 @@
+#ifndef JWUTIL_WORKQUEUECOROUTINE_H
+#define JWUTIL_WORKQUEUECOROUTINE_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <tuple>
+
+#include "workqueuebase.h"
+#include "slaballocator.h"
+
+namespace jw_util
+{
+
+// Allocates coroutine frames from SlabAllocator, so starting a coroutine doesn't go to the global heap once it's warm.
+// A frame is usually freed on whichever worker resumed it last, rather than the thread that started it,
+// so it goes back through SlabAllocator's depot in batches, where the starting thread's next refill picks it up.
+
+class WorkQueueFrameAllocator
+{
+public:
+    WorkQueueFrameAllocator() = delete;
+
+    static void *allocate(std::size_t size)
+    {
+        return jw_util::SlabAllocator::alloc(get_alloc_size(size));
+    }
+
+    static void deallocate(void *ptr, std::size_t size)
+    {
+        jw_util::SlabAllocator::free(ptr, get_alloc_size(size));
+    }
+
+private:
+    // Slab blocks at least this big are aligned like operator new's result, which is what a frame needs
+    static std::size_t get_alloc_size(std::size_t size)
+    {
+        return size > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? size : __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+};
+
+// A fire-and-forget coroutine: it starts running as soon as it's called, and its frame is freed when it returns.
+// Use co_await queue.schedule() inside it to move onto a worker thread.
+
+class WorkQueueTask
+{
+public:
+    struct promise_type
+    {
+        WorkQueueTask get_return_object() {return WorkQueueTask();}
+        std::suspend_never initial_suspend() noexcept {return {};}
+        std::suspend_never final_suspend() noexcept {return {};}
+        void return_void() {}
+        void unhandled_exception() {std::terminate();}
+
+        static void *operator new(std::size_t size)
+        {
+            return WorkQueueFrameAllocator::allocate(size);
+        }
+
+        static void operator delete(void *ptr, std::size_t size)
+        {
+            WorkQueueFrameAllocator::deallocate(ptr, size);
+        }
+    };
+};
+
+// A WorkQueue that can also resume coroutines: co_await queue.schedule() suspends the calling coroutine and resumes it on a worker.
+// Regular pushes still go to the worker callback. Each ArgType has to be default-constructible, since coroutine tasks carry default values for them.
+// Coroutines still queued when pause_until() or pause_drop() gives up are never resumed; the returned tuples hold their handles, so the caller can destroy them.
+
+template <unsigned int num_threads, typename... ArgTypes>
+class WorkQueueCoroutine : public WorkQueueBase<WorkQueueCoroutine<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, std::coroutine_handle<>, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueueCoroutine<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, std::coroutine_handle<>, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    class ScheduleAwaiter
+    {
+    public:
+        ScheduleAwaiter(WorkQueueCoroutine *owner)
+            : queue(owner)
+        {}
+
+        // Without workers, the coroutine just keeps running on the calling thread
+        bool await_ready() const noexcept {return num_threads == 0;}
+
+        // The coroutine can be resumed (and even finish) on a worker before this returns, so nothing can be touched after the push
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            queue->push_coroutine(handle);
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        WorkQueueCoroutine *queue;
+    };
+
+    WorkQueueCoroutine(jw_util::MethodCallback<ArgTypes...> worker = jw_util::MethodCallback<ArgTypes...>())
+        : BaseType(create_worker(this), BaseType::construct_paused)
+        , task_worker(worker)
+    {
+        BaseType::start();
+    }
+
+    WorkQueueCoroutine(jw_util::MethodCallback<ArgTypes...> worker, typename BaseType::construct_paused_t)
+        : BaseType(create_worker(this), BaseType::construct_paused)
+        , task_worker(worker)
+    {}
+
+    ~WorkQueueCoroutine()
+    {
+        if (BaseType::running)
+        {
+            BaseType::pause();
+        }
+    }
+
+    void push(ArgTypes... args)
+    {
+        BaseType::push(std::coroutine_handle<>(), std::forward<ArgTypes>(args)...);
+    }
+
+    ScheduleAwaiter schedule()
+    {
+        return ScheduleAwaiter(this);
+    }
+
+private:
+    const jw_util::MethodCallback<ArgTypes...> task_worker;
+
+    static jw_util::MethodCallback<std::coroutine_handle<>, ArgTypes...> create_worker(WorkQueueCoroutine *inst)
+    {
+        return jw_util::MethodCallback<std::coroutine_handle<>, ArgTypes...>::template create<WorkQueueCoroutine, &WorkQueueCoroutine::run>(inst);
+    }
+
+    void push_coroutine(std::coroutine_handle<> handle)
+    {
+        std::tuple<typename std::remove_reference<ArgTypes>::type...> placeholders;
+        std::apply([this, handle](typename std::remove_reference<ArgTypes>::type &... args)
+        {
+            BaseType::push(handle, static_cast<ArgTypes>(args)...);
+        }, placeholders);
+    }
+
+    void run(std::coroutine_handle<> handle, ArgTypes... args)
+    {
+        if (handle)
+        {
+            handle.resume();
+        }
+        else
+        {
+            task_worker.call(std::forward<ArgTypes>(args)...);
+        }
+    }
+
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        BaseType::conditional_variable.wait(lock);
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUECOROUTINE_H
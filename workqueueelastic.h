@@ -0,0 +1,40 @@
+#ifndef JWUTIL_WORKQUEUEELASTIC_H
+#define JWUTIL_WORKQUEUEELASTIC_H
+
+#include "workqueuebase.h"
+
+namespace jw_util
+{
+
+// Takes its thread count at construction (defaulting to the number of hardware threads) instead of as a template parameter.
+// After set_elastic(), it spawns workers while tasks are backing up, and retires workers that have been idle for the idle timeout.
+
+template <typename... ArgTypes>
+class WorkQueueElastic : public WorkQueueBase<WorkQueueElastic<ArgTypes...>, work_queue_dynamic_threads, WorkQueueTraits, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueueElastic<ArgTypes...>, work_queue_dynamic_threads, WorkQueueTraits, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    using BaseType::WorkQueueBase;
+
+private:
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        if (BaseType::elastic.load(std::memory_order_relaxed))
+        {
+            if (BaseType::conditional_variable.wait_for(lock, BaseType::elastic_idle_timeout) == std::cv_status::timeout)
+            {
+                BaseType::retire_idle_thread();
+            }
+        }
+        else
+        {
+            BaseType::conditional_variable.wait(lock);
+        }
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUEELASTIC_H
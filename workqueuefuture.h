@@ -0,0 +1,306 @@
+#ifndef JWUTIL_WORKQUEUEFUTURE_H
+#define JWUTIL_WORKQUEUEFUTURE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+#include <chrono>
+
+#include "workqueuebase.h"
+#include "slaballocator.h"
+
+namespace jw_util
+{
+
+// Shared state between a WorkQueueHandle and the task it tracks.
+// Allocated from SlabAllocator, whose per-thread caches only take a lock once per batch of allocations or frees,
+// even though completions are usually freed on a different thread than they were allocated on.
+
+class WorkQueueCompletion
+{
+    friend class WorkQueueHandle;
+
+public:
+    static WorkQueueCompletion *create()
+    {
+        return jw_util::SlabAllocator::create<WorkQueueCompletion>();
+    }
+
+    void complete();
+
+    // Completes without the task having run, e.g. because the queue dropped it
+    void cancel();
+
+private:
+    enum Status : unsigned char {pending, has_continuation, done};
+
+    // One reference for the handle, one for the queued task
+    std::atomic<unsigned int> refs {2};
+    std::atomic<unsigned char> status {pending};
+    std::atomic<bool> cancelled {false};
+
+    // Set by a handle that's about to block in wait(), so complete() only locks anything if someone's actually waiting
+    std::atomic<bool> has_waiter {false};
+
+    jw_util::MethodCallback<> continuation;
+
+    // Blocked waiters park on one of these, picked by the completion's address, so completing a task only wakes the waiters that share its slot
+    struct ParkingSlot
+    {
+        std::mutex mutex;
+        std::condition_variable conditional_variable;
+    };
+
+    static constexpr unsigned int num_parking_slots = 64;
+
+    ParkingSlot &get_parking_slot()
+    {
+        static ParkingSlot slots[num_parking_slots];
+        return slots[(reinterpret_cast<std::uintptr_t>(this) / sizeof(WorkQueueCompletion)) % num_parking_slots];
+    }
+
+    bool is_done() const
+    {
+        return status.load(std::memory_order_acquire) == done;
+    }
+
+    void release();
+};
+
+inline void WorkQueueCompletion::complete()
+{
+    unsigned char prev = status.exchange(done, std::memory_order_seq_cst);
+    if (prev == has_continuation)
+    {
+        continuation.call();
+    }
+
+    if (has_waiter.load(std::memory_order_seq_cst))
+    {
+        ParkingSlot &slot = get_parking_slot();
+        {
+            // Make sure the waiter is either before its status check or inside wait()
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            (void) lock;
+        }
+
+        // Other completions' waiters might share the slot, so they all have to recheck
+        slot.conditional_variable.notify_all();
+    }
+
+    release();
+}
+
+inline void WorkQueueCompletion::cancel()
+{
+    cancelled.store(true, std::memory_order_relaxed);
+    complete();
+}
+
+inline void WorkQueueCompletion::release()
+{
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        jw_util::SlabAllocator::destroy(this);
+    }
+}
+
+// Future-like handle returned by WorkQueueFuture::push_handle
+
+class WorkQueueHandle
+{
+public:
+    WorkQueueHandle()
+        : completion(0)
+    {}
+
+    explicit WorkQueueHandle(WorkQueueCompletion *completion)
+        : completion(completion)
+    {}
+
+    WorkQueueHandle(WorkQueueHandle &&other)
+        : completion(other.completion)
+    {
+        other.completion = 0;
+    }
+
+    WorkQueueHandle &operator=(WorkQueueHandle &&other)
+    {
+        if (completion)
+        {
+            completion->release();
+        }
+        completion = other.completion;
+        other.completion = 0;
+        return *this;
+    }
+
+    WorkQueueHandle(const WorkQueueHandle &) = delete;
+    WorkQueueHandle &operator=(const WorkQueueHandle &) = delete;
+
+    ~WorkQueueHandle()
+    {
+        if (completion)
+        {
+            completion->release();
+        }
+    }
+
+    bool is_valid() const {return completion;}
+
+    bool poll() const
+    {
+        assert(completion);
+        return completion->is_done();
+    }
+
+    // True if the task was dropped by WorkQueueFuture::pause_until or pause_drop instead of running. Only meaningful once poll() returns true.
+    bool is_cancelled() const
+    {
+        assert(completion);
+        return completion->is_done() && completion->cancelled.load(std::memory_order_relaxed);
+    }
+
+    void wait() const
+    {
+        assert(completion);
+
+        for (unsigned int i = 0; i < 64; i++)
+        {
+            if (completion->is_done()) {return;}
+            std::this_thread::yield();
+        }
+
+        WorkQueueCompletion::ParkingSlot &slot = completion->get_parking_slot();
+        std::unique_lock<std::mutex> lock(slot.mutex);
+        completion->has_waiter.store(true, std::memory_order_seq_cst);
+        while (completion->status.load(std::memory_order_seq_cst) != WorkQueueCompletion::done)
+        {
+            slot.conditional_variable.wait(lock);
+        }
+    }
+
+    // Calls continuation from the worker thread when the task finishes (or is cancelled), or right away if it already has. Can only be set once.
+    void then(jw_util::MethodCallback<> continuation)
+    {
+        assert(completion);
+        assert(!completion->continuation.is_valid());
+
+        completion->continuation = continuation;
+
+        unsigned char expected = WorkQueueCompletion::pending;
+        if (!completion->status.compare_exchange_strong(expected, WorkQueueCompletion::has_continuation, std::memory_order_acq_rel))
+        {
+            assert(expected == WorkQueueCompletion::done);
+            continuation.call();
+        }
+    }
+
+private:
+    WorkQueueCompletion *completion;
+};
+
+// Like WorkQueue, but push_handle returns a WorkQueueHandle that tracks when the task has finished.
+// Tasks that pause_until or pause_drop never run are cancelled, so their handles still complete.
+
+template <unsigned int num_threads, typename... ArgTypes>
+class WorkQueueFuture : public WorkQueueBase<WorkQueueFuture<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, WorkQueueCompletion *, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueueFuture<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, WorkQueueCompletion *, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    WorkQueueFuture(jw_util::MethodCallback<ArgTypes...> worker)
+        : BaseType(create_worker(this), BaseType::construct_paused)
+        , task_worker(worker)
+    {
+        BaseType::start();
+    }
+
+    WorkQueueFuture(jw_util::MethodCallback<ArgTypes...> worker, typename BaseType::construct_paused_t)
+        : BaseType(create_worker(this), BaseType::construct_paused)
+        , task_worker(worker)
+    {}
+
+    ~WorkQueueFuture()
+    {
+        if (BaseType::running)
+        {
+            BaseType::pause();
+        }
+    }
+
+    void push(ArgTypes... args)
+    {
+        BaseType::push(0, std::forward<ArgTypes>(args)...);
+    }
+
+    WorkQueueHandle push_handle(ArgTypes... args)
+    {
+        WorkQueueCompletion *completion = WorkQueueCompletion::create();
+        BaseType::push(completion, std::forward<ArgTypes>(args)...);
+        return WorkQueueHandle(completion);
+    }
+
+    typedef std::tuple<typename std::remove_reference<ArgTypes>::type...> ArgsTupleType;
+
+    // Same as WorkQueueBase::pause_until, but cancels the handles of the tasks that never ran, and returns just their arguments
+    std::vector<ArgsTupleType> pause_until(std::chrono::steady_clock::time_point deadline)
+    {
+        std::vector<typename BaseType::TupleType> remaining = BaseType::pause_until(deadline);
+
+        std::vector<ArgsTupleType> res;
+        res.reserve(remaining.size());
+        for (typename BaseType::TupleType &task : remaining)
+        {
+            if (std::get<0>(task))
+            {
+                std::get<0>(task)->cancel();
+            }
+            res.push_back(strip_completion(std::move(task), std::index_sequence_for<ArgTypes...>{}));
+        }
+        return res;
+    }
+
+    std::size_t pause_drop()
+    {
+        return pause_until(std::chrono::steady_clock::time_point::min()).size();
+    }
+
+private:
+    const jw_util::MethodCallback<ArgTypes...> task_worker;
+
+    static jw_util::MethodCallback<WorkQueueCompletion *, ArgTypes...> create_worker(WorkQueueFuture *inst)
+    {
+        return jw_util::MethodCallback<WorkQueueCompletion *, ArgTypes...>::template create<WorkQueueFuture, &WorkQueueFuture::run>(inst);
+    }
+
+    void run(WorkQueueCompletion *completion, ArgTypes... args)
+    {
+        task_worker.call(std::forward<ArgTypes>(args)...);
+
+        if (completion)
+        {
+            completion->complete();
+        }
+    }
+
+    template <std::size_t... Indices>
+    static ArgsTupleType strip_completion(typename BaseType::TupleType &&task, std::index_sequence<Indices...>)
+    {
+        return ArgsTupleType(std::move(std::get<Indices + 1>(task))...);
+    }
+
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        BaseType::conditional_variable.wait(lock);
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUEFUTURE_H
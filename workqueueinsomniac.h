@@ -1,52 +1,201 @@
 #ifndef JWUTIL_WORKQUEUEINSOMNIAC_H
 #define JWUTIL_WORKQUEUEINSOMNIAC_H
 
+#include <atomic>
 #include <chrono>
+#include <vector>
 
 #include "workqueuebase.h"
+#include "timerwheel.h"
 
 namespace jw_util
 {
 
+// A WorkQueue whose idle workers also fire timers, so one-shot and periodic callbacks don't need threads of their own.
+// One idle worker at a time (the timer keeper) sleeps until the next timer is due; the rest sleep until a task arrives.
+// Timers fire with the queue unlocked, but only when a worker is idle, so they can be late while every worker is busy.
+
 template <unsigned int num_threads, typename... ArgTypes>
-class WorkQueueInsomniac : public WorkQueueBase<WorkQueueInsomniac<num_threads, ArgTypes...>, num_threads, ArgTypes...>
+class WorkQueueInsomniac : public WorkQueueBase<WorkQueueInsomniac<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, ArgTypes...>
 {
-    typedef WorkQueueBase<WorkQueueInsomniac<num_threads, ArgTypes...>, num_threads, ArgTypes...> BaseType;
+    typedef WorkQueueBase<WorkQueueInsomniac<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, ArgTypes...> BaseType;
     friend BaseType;
 
 public:
-    using WorkQueueBase<WorkQueueInsomniac<num_threads, ArgTypes...>, num_threads, ArgTypes...>::WorkQueueBase;
+    typedef TimerWheel::TimerId TimerId;
+
+    // The workers call wait() as soon as they start, so they can't be started until our members are constructed
+    WorkQueueInsomniac(jw_util::MethodCallback<ArgTypes...> worker)
+        : BaseType(worker, BaseType::construct_paused)
+    {
+        BaseType::start();
+    }
+
+    WorkQueueInsomniac(jw_util::MethodCallback<ArgTypes...> worker, typename BaseType::construct_paused_t)
+        : BaseType(worker, BaseType::construct_paused)
+    {}
+
+    ~WorkQueueInsomniac()
+    {
+        if (BaseType::running)
+        {
+            BaseType::pause();
+        }
+    }
 
     void set_wakeup_worker(jw_util::MethodCallback<> worker)
     {
+        std::lock_guard<std::mutex> lock(BaseType::mutex);
+        (void) lock;
         wakeup_worker = worker;
     }
 
+    // Calls the wakeup worker now, and then every interval
     template <typename DurationRep, typename DurationPeriod>
     void set_wakeup_interval(std::chrono::duration<DurationRep, DurationPeriod> duration)
     {
-        next_wakeup = std::chrono::steady_clock::now();
-        wakeup_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+        {
+            std::lock_guard<std::mutex> lock(BaseType::mutex);
+            (void) lock;
+            timers.cancel(wakeup_timer);
+        }
+
+        wakeup_timer = add_timer(std::chrono::steady_clock::now(), jw_util::MethodCallback<>::create<WorkQueueInsomniac, &WorkQueueInsomniac::call_wakeup_worker>(this), std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+    }
+
+    TimerId add_timer(std::chrono::steady_clock::time_point when, jw_util::MethodCallback<> callback, std::chrono::steady_clock::duration period = std::chrono::steady_clock::duration::zero())
+    {
+        TimerId id;
+        bool wake_keeper;
+        bool wake_sleeper;
+        {
+            std::lock_guard<std::mutex> lock(BaseType::mutex);
+            (void) lock;
+
+            std::chrono::steady_clock::time_point prev_expiry = timers.get_next_expiry();
+            id = timers.add(when, callback, period);
+
+            bool has_keeper = timer_keeper.load(std::memory_order_relaxed);
+            wake_keeper = has_keeper && timers.get_next_expiry() < prev_expiry;
+            wake_sleeper = !has_keeper && BaseType::sleeping.load(std::memory_order_relaxed);
+        }
+
+        if (wake_keeper)
+        {
+            timer_variable.notify_one();
+        }
+        else if (wake_sleeper)
+        {
+            BaseType::conditional_variable.notify_one();
+        }
+
+        return id;
+    }
+
+    template <typename DurationRep, typename DurationPeriod>
+    TimerId add_timer(std::chrono::duration<DurationRep, DurationPeriod> delay, jw_util::MethodCallback<> callback)
+    {
+        return add_timer(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay), callback);
+    }
+
+    // First fires one period from now
+    template <typename DurationRep, typename DurationPeriod>
+    TimerId add_periodic_timer(std::chrono::duration<DurationRep, DurationPeriod> period, jw_util::MethodCallback<> callback)
+    {
+        std::chrono::steady_clock::duration steady_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        return add_timer(std::chrono::steady_clock::now() + steady_period, callback, steady_period);
+    }
+
+    // Returns false if the timer already fired (for a one-shot timer) or was already cancelled.
+    // A timer that's being fired on another thread right now can still run once after this returns.
+    bool cancel_timer(TimerId id)
+    {
+        std::lock_guard<std::mutex> lock(BaseType::mutex);
+        (void) lock;
+        return timers.cancel(id);
     }
 
 private:
+    // Everything below is guarded by BaseType::mutex
+    TimerWheel timers;
+    std::condition_variable timer_variable;
+    std::atomic<bool> timer_keeper {false};
+
     jw_util::MethodCallback<> wakeup_worker;
+    TimerId wakeup_timer;
+
+    void call_wakeup_worker()
+    {
+        jw_util::MethodCallback<> worker;
+        {
+            std::lock_guard<std::mutex> lock(BaseType::mutex);
+            (void) lock;
+            worker = wakeup_worker;
+        }
 
-    std::chrono::steady_clock::time_point next_wakeup = std::chrono::steady_clock::time_point::max();
-    std::chrono::steady_clock::duration wakeup_interval = std::chrono::steady_clock::duration::max();
+        if (worker.is_valid())
+        {
+            worker.call();
+        }
+    }
 
     void wait(std::unique_lock<std::mutex> &lock)
     {
-        std::cv_status status = BaseType::conditional_variable.wait_until(lock, next_wakeup);
+        if (timer_keeper.load(std::memory_order_relaxed) || timers.empty())
+        {
+            BaseType::conditional_variable.wait(lock);
+        }
+        else
+        {
+            timer_keeper.store(true, std::memory_order_relaxed);
+            std::cv_status status = timer_variable.wait_until(lock, timers.get_next_expiry());
+            timer_keeper.store(false, std::memory_order_relaxed);
+
+            // We were probably woken for a task, so hand the timers to another idle worker
+            if (status == std::cv_status::no_timeout && !timers.empty() && BaseType::sleeping.load(std::memory_order_relaxed) > 1)
+            {
+                BaseType::conditional_variable.notify_one();
+            }
+        }
+
+        fire_timers(lock);
+    }
+
+    void fire_timers(std::unique_lock<std::mutex> &lock)
+    {
+        if (timers.empty()) {return;}
+
+        std::vector<jw_util::MethodCallback<>> due;
+        timers.advance(std::chrono::steady_clock::now(), due);
+        if (due.empty()) {return;}
+
+        lock.unlock();
+        for (const jw_util::MethodCallback<> &callback : due)
+        {
+            callback.call();
+        }
+        lock.lock();
+    }
 
-        if (status == std::cv_status::timeout)
+    // Tasks have to wake the keeper if it's the only worker asleep
+    void notify_one()
+    {
+        unsigned int keepers = timer_keeper.load(std::memory_order_relaxed) ? 1 : 0;
+        if (BaseType::sleeping.load(std::memory_order_relaxed) > keepers)
+        {
+            BaseType::conditional_variable.notify_one();
+        }
+        else
         {
-            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-            next_wakeup += wakeup_interval;
-            if (next_wakeup < now) {next_wakeup = now;}
-            wakeup_worker.call();
+            timer_variable.notify_one();
         }
     }
+
+    void notify_all()
+    {
+        BaseType::conditional_variable.notify_all();
+        timer_variable.notify_all();
+    }
 };
 
 }
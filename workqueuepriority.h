@@ -0,0 +1,198 @@
+#ifndef JWUTIL_WORKQUEUEPRIORITY_H
+#define JWUTIL_WORKQUEUEPRIORITY_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <functional>
+
+#include "workqueuebase.h"
+#include "pool.h"
+
+namespace jw_util
+{
+
+// Runs tasks in order of priority, where a lower priority value runs first (so a deadline works as the priority too).
+// Ties run in the order they were pushed.
+// To keep low-priority tasks from starving, every fairness_interval'th pop takes the oldest task instead of the most urgent one.
+// Each task is referenced by both the heap and the fifo, and whichever one doesn't pop it drops it lazily once it reaches the top.
+
+template <typename TaskType, typename PriorityType, typename Compare = std::less<PriorityType>>
+class WorkQueueStoragePriority
+{
+public:
+    static constexpr bool is_lock_free = false;
+
+    bool empty() const {return !count;}
+    std::size_t size() const {return count;}
+
+    template <typename... ArgTypes>
+    void emplace(PriorityType priority, ArgTypes &&... args)
+    {
+        Entry *entry = entries.alloc(priority, next_order++, std::forward<ArgTypes>(args)...);
+
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), HeapCompare());
+
+        fifo.push_back(entry);
+
+        count++;
+        next = 0;
+    }
+
+    TaskType &front()
+    {
+        assert(count);
+
+        if (!next)
+        {
+            drop_taken();
+
+            pop_fair = fairness_interval && pops_since_fair + 1 >= fairness_interval;
+            next = pop_fair ? fifo.front() : heap.front();
+        }
+
+        return next->task;
+    }
+
+    void pop()
+    {
+        front();
+
+        if (pop_fair)
+        {
+            assert(next == fifo.front());
+            fifo.pop_front();
+            pops_since_fair = 0;
+        }
+        else
+        {
+            assert(next == heap.front());
+            std::pop_heap(heap.begin(), heap.end(), HeapCompare());
+            heap.pop_back();
+            pops_since_fair++;
+        }
+
+        next->taken = true;
+        next = 0;
+        count--;
+    }
+
+    // 0 disables starvation protection
+    void set_fairness_interval(unsigned int interval)
+    {
+        fairness_interval = interval;
+    }
+
+private:
+    struct Entry
+    {
+        // Only so Pool can refill freed slots before it's destroyed
+        Entry() = default;
+
+        template <typename... ArgTypes>
+        Entry(PriorityType priority, unsigned long long order, ArgTypes &&... args)
+            : priority(priority)
+            , order(order)
+            , task(std::forward<ArgTypes>(args)...)
+        {}
+
+        PriorityType priority;
+        unsigned long long order;
+        TaskType task;
+        bool taken = false;
+    };
+
+    struct HeapCompare
+    {
+        bool operator()(const Entry *a, const Entry *b) const
+        {
+            // std::push_heap builds a max-heap, so this returns true if a should run after b
+            if (Compare()(b->priority, a->priority)) {return true;}
+            if (Compare()(a->priority, b->priority)) {return false;}
+            return a->order > b->order;
+        }
+    };
+
+    jw_util::Pool<Entry> entries;
+    std::vector<Entry *> heap;
+    std::deque<Entry *> fifo;
+
+    std::size_t count = 0;
+    unsigned long long next_order = 0;
+
+    Entry *next = 0;
+    bool pop_fair = false;
+
+    unsigned int fairness_interval = 32;
+    unsigned int pops_since_fair = 0;
+
+    // Entries already popped through the other container can be freed once they reach the top of this one
+    void drop_taken()
+    {
+        while (heap.front()->taken)
+        {
+            entries.free(heap.front());
+            std::pop_heap(heap.begin(), heap.end(), HeapCompare());
+            heap.pop_back();
+        }
+
+        while (fifo.front()->taken)
+        {
+            entries.free(fifo.front());
+            fifo.pop_front();
+        }
+    }
+};
+
+template <typename PriorityType, typename Compare = std::less<PriorityType>>
+struct WorkQueueTraitsPriority : public WorkQueueTraits
+{
+    template <typename TaskType>
+    using Storage = WorkQueueStoragePriority<TaskType, PriorityType, Compare>;
+};
+
+template <unsigned int num_threads, typename PriorityType, typename... ArgTypes>
+class WorkQueuePriority : public WorkQueueBase<WorkQueuePriority<num_threads, PriorityType, ArgTypes...>, num_threads, WorkQueueTraitsPriority<PriorityType>, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueuePriority<num_threads, PriorityType, ArgTypes...>, num_threads, WorkQueueTraitsPriority<PriorityType>, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    using BaseType::WorkQueueBase;
+
+    void push(PriorityType priority, ArgTypes... args)
+    {
+        assert(BaseType::running);
+
+        if (num_threads)
+        {
+            BaseType::push_task(priority, std::forward<ArgTypes>(args)...);
+        }
+        else
+        {
+            BaseType::worker.call(std::forward<ArgTypes>(args)...);
+        }
+    }
+
+    // Every task needs a priority, which the base's batches don't have
+    template <typename IteratorType>
+    void push_batch(IteratorType begin, IteratorType end) = delete;
+
+    void set_fairness_interval(unsigned int interval)
+    {
+        std::lock_guard<std::mutex> lock(BaseType::mutex);
+        (void) lock;
+        BaseType::queue.set_fairness_interval(interval);
+    }
+
+private:
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        BaseType::conditional_variable.wait(lock);
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUEPRIORITY_H
@@ -0,0 +1,39 @@
+#ifndef JWUTIL_WORKQUEUERING_H
+#define JWUTIL_WORKQUEUERING_H
+
+#include "workqueuebase.h"
+#include "ringmpmc.h"
+
+namespace jw_util
+{
+
+// Stores tasks in a fixed-size lock-free ring, so push and pop don't take the mutex or allocate.
+// The mutex is only taken to sleep when the ring is empty, or to block a pusher when it's full.
+// TupleType must be default-constructible, since workers pop into a reused local.
+
+template <unsigned int capacity>
+struct WorkQueueTraitsRing : public WorkQueueTraits
+{
+    template <typename TaskType>
+    using Storage = RingMPMC<TaskType, capacity>;
+};
+
+template <unsigned int num_threads, unsigned int capacity, typename... ArgTypes>
+class WorkQueueRing : public WorkQueueBase<WorkQueueRing<num_threads, capacity, ArgTypes...>, num_threads, WorkQueueTraitsRing<capacity>, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueueRing<num_threads, capacity, ArgTypes...>, num_threads, WorkQueueTraitsRing<capacity>, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    using BaseType::WorkQueueBase;
+
+private:
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        BaseType::conditional_variable.wait(lock);
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUERING_H
@@ -0,0 +1,163 @@
+#ifndef JWUTIL_WORKQUEUESPINNING_H
+#define JWUTIL_WORKQUEUESPINNING_H
+
+#include <atomic>
+#include <thread>
+
+#include "workqueuebase.h"
+
+namespace jw_util
+{
+
+// Idle workers spin for a while, then yield for a while, and only then sleep on the condition variable.
+// A task pushed shortly after a worker went idle is picked up without paying for a futex wake-up,
+// and push only has to touch the condition variable when some worker actually went to sleep.
+
+template <unsigned int num_threads, typename... ArgTypes>
+class WorkQueueSpinning : public WorkQueueBase<WorkQueueSpinning<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueueSpinning<num_threads, ArgTypes...>, num_threads, WorkQueueTraits, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    // The workers call wait() as soon as they start, so they can't be started until our members are constructed
+    WorkQueueSpinning(jw_util::MethodCallback<ArgTypes...> worker)
+        : BaseType(worker, BaseType::construct_paused)
+    {
+        BaseType::start();
+    }
+
+    WorkQueueSpinning(jw_util::MethodCallback<ArgTypes...> worker, typename BaseType::construct_paused_t)
+        : BaseType(worker, BaseType::construct_paused)
+    {}
+
+    ~WorkQueueSpinning()
+    {
+        if (BaseType::running)
+        {
+            BaseType::pause();
+        }
+    }
+
+    // How many times each phase of waiting was the one that ended with a wake-up
+    struct WaitStats
+    {
+        unsigned long long spin_wakeups;
+        unsigned long long yield_wakeups;
+        unsigned long long park_wakeups;
+    };
+
+    void set_spin_count(unsigned int count)
+    {
+        spin_count.store(count, std::memory_order_relaxed);
+    }
+
+    void set_yield_count(unsigned int count)
+    {
+        yield_count.store(count, std::memory_order_relaxed);
+    }
+
+    WaitStats get_wait_stats() const
+    {
+        WaitStats res;
+        res.spin_wakeups = spin_wakeups.load(std::memory_order_relaxed);
+        res.yield_wakeups = yield_wakeups.load(std::memory_order_relaxed);
+        res.park_wakeups = park_wakeups.load(std::memory_order_relaxed);
+        return res;
+    }
+
+private:
+    // Incremented every time the base would have notified the condition variable
+    alignas(64) std::atomic<unsigned int> notify_epoch {0};
+
+    // Number of workers actually blocked on the condition variable
+    alignas(64) std::atomic<unsigned int> parked {0};
+
+    std::atomic<unsigned int> spin_count {4096};
+    std::atomic<unsigned int> yield_count {16};
+
+    std::atomic<unsigned long long> spin_wakeups {0};
+    std::atomic<unsigned long long> yield_wakeups {0};
+    std::atomic<unsigned long long> park_wakeups {0};
+
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        // Read while holding the lock, so any push we haven't seen yet will bump the epoch after this
+        unsigned int epoch = notify_epoch.load(std::memory_order_relaxed);
+        lock.unlock();
+
+        unsigned int spins = spin_count.load(std::memory_order_relaxed);
+        for (unsigned int i = 0; i < spins; i++)
+        {
+            if (notify_epoch.load(std::memory_order_acquire) != epoch)
+            {
+                spin_wakeups.fetch_add(1, std::memory_order_relaxed);
+                lock.lock();
+                return;
+            }
+            cpu_relax();
+        }
+
+        unsigned int yields = yield_count.load(std::memory_order_relaxed);
+        for (unsigned int i = 0; i < yields; i++)
+        {
+            std::this_thread::yield();
+            if (notify_epoch.load(std::memory_order_acquire) != epoch)
+            {
+                yield_wakeups.fetch_add(1, std::memory_order_relaxed);
+                lock.lock();
+                return;
+            }
+        }
+
+        lock.lock();
+        parked.fetch_add(1, std::memory_order_seq_cst);
+        if (notify_epoch.load(std::memory_order_seq_cst) == epoch)
+        {
+            BaseType::conditional_variable.wait(lock);
+        }
+        parked.fetch_sub(1, std::memory_order_relaxed);
+
+        park_wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void notify_one()
+    {
+        notify_epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_seq_cst))
+        {
+            {
+                // Make sure the parking worker is either before its epoch check or inside wait()
+                std::lock_guard<std::mutex> lock(BaseType::mutex);
+                (void) lock;
+            }
+            BaseType::conditional_variable.notify_one();
+        }
+    }
+
+    void notify_all()
+    {
+        notify_epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_seq_cst))
+        {
+            {
+                std::lock_guard<std::mutex> lock(BaseType::mutex);
+                (void) lock;
+            }
+            BaseType::conditional_variable.notify_all();
+        }
+    }
+
+    static void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUESPINNING_H
@@ -0,0 +1,181 @@
+#ifndef JWUTIL_WORKQUEUESTEALING_H
+#define JWUTIL_WORKQUEUESTEALING_H
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+#include "workqueuebase.h"
+
+namespace jw_util
+{
+
+// Task storage where every worker thread owns a deque with its own mutex, instead of all of them sharing one queue.
+// Tasks a worker pushes go onto its own deque, and it pops the newest of them first, since that's the most likely to still be in cache.
+// Tasks pushed from any other thread go into a shared injector queue, which is FIFO, so from outside this behaves like WorkQueue.
+// A worker with nothing of its own takes from the injector, and then steals the oldest task from the front of its siblings' deques.
+// Every so often it checks the injector first, so a worker that keeps spawning tasks can't starve the ones pushed from outside.
+// Workers must call set_owner() before popping; any other thread that pops (e.g. draining during a pause) only takes from the fronts.
+// It counts as lock-free storage, so WorkQueueBase only takes its mutex to sleep and wake workers.
+
+template <typename TaskType, unsigned int num_deques>
+class WorkQueueStorageStealing
+{
+    static_assert(num_deques > 0, "WorkQueueStorageStealing<TaskType, num_deques>: Must have at least one deque");
+
+public:
+    static constexpr bool is_lock_free = true;
+
+    bool empty() const {return !pending.load(std::memory_order_relaxed);}
+    std::size_t size() const {return pending.load(std::memory_order_relaxed);}
+
+    // Makes the calling thread the owner of deque index % num_deques, for as long as the thread lives
+    void set_owner(unsigned int index)
+    {
+        thread_storage = this;
+        thread_index = index % num_deques;
+        thread_pops = 0;
+    }
+
+    // Never fails, since the deques grow
+    template <typename... ArgTypes>
+    bool try_emplace(ArgTypes &&... args)
+    {
+        // Count the task before it becomes visible, so a pop can never take pending below zero
+        pending.fetch_add(1, std::memory_order_relaxed);
+
+        Deque &deque = thread_storage == this ? deques[thread_index] : injector;
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        (void) lock;
+        deque.queue.emplace_back(std::forward<ArgTypes>(args)...);
+        return true;
+    }
+
+    bool try_pop(TaskType &task)
+    {
+        if (thread_storage != this)
+        {
+            if (pop_from(injector, task, false, true)) {return true;}
+            for (unsigned int i = 0; i < num_deques; i++)
+            {
+                if (pop_from(deques[i], task, false, true)) {return true;}
+            }
+            return false;
+        }
+
+        if (++thread_pops % injector_interval == 0)
+        {
+            if (pop_from(injector, task, false, true)) {return true;}
+        }
+
+        if (pop_from(deques[thread_index], task, true, true)) {return true;}
+        if (pop_from(injector, task, false, true)) {return true;}
+
+        // The first pass doesn't wait on a sibling that's busy, and just moves on to the next one.
+        // The second pass does, so a pop only fails if every deque really was empty.
+        for (unsigned int pass = 0; pass < 2; pass++)
+        {
+            for (unsigned int i = 1; i < num_deques; i++)
+            {
+                if (pop_from(deques[(thread_index + i) % num_deques], task, false, pass)) {return true;}
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static constexpr unsigned int injector_interval = 61;
+
+    struct alignas(64) Deque
+    {
+        std::mutex mutex;
+        std::deque<TaskType> queue;
+    };
+
+    std::array<Deque, num_deques> deques;
+    Deque injector;
+
+    // Number of tasks pushed but not yet popped, across all deques and the injector
+    alignas(64) std::atomic<unsigned int> pending {0};
+
+    static thread_local const WorkQueueStorageStealing *thread_storage;
+    static thread_local unsigned int thread_index;
+    static thread_local unsigned int thread_pops;
+
+    bool pop_from(Deque &deque, TaskType &task, bool newest, bool wait)
+    {
+        std::unique_lock<std::mutex> lock(deque.mutex, std::defer_lock);
+        if (wait)
+        {
+            lock.lock();
+        }
+        else if (!lock.try_lock())
+        {
+            return false;
+        }
+
+        if (deque.queue.empty()) {return false;}
+
+        if (newest)
+        {
+            task = std::move(deque.queue.back());
+            deque.queue.pop_back();
+        }
+        else
+        {
+            task = std::move(deque.queue.front());
+            deque.queue.pop_front();
+        }
+        lock.unlock();
+
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+template <typename TaskType, unsigned int num_deques>
+thread_local const WorkQueueStorageStealing<TaskType, num_deques> *WorkQueueStorageStealing<TaskType, num_deques>::thread_storage = 0;
+
+template <typename TaskType, unsigned int num_deques>
+thread_local unsigned int WorkQueueStorageStealing<TaskType, num_deques>::thread_index = 0;
+
+template <typename TaskType, unsigned int num_deques>
+thread_local unsigned int WorkQueueStorageStealing<TaskType, num_deques>::thread_pops = 0;
+
+template <unsigned int num_deques>
+struct WorkQueueTraitsStealing : public WorkQueueTraits
+{
+    template <typename TaskType>
+    using Storage = WorkQueueStorageStealing<TaskType, num_deques>;
+};
+
+// TupleType must be default-constructible, since workers pop into a reused local
+
+template <unsigned int num_threads, typename... ArgTypes>
+class WorkQueueStealing : public WorkQueueBase<WorkQueueStealing<num_threads, ArgTypes...>, num_threads, WorkQueueTraitsStealing<num_threads && num_threads != work_queue_dynamic_threads ? num_threads : 1>, ArgTypes...>
+{
+    static_assert(num_threads != work_queue_dynamic_threads, "WorkQueueStealing: Needs a fixed number of threads, one per deque");
+
+    typedef WorkQueueBase<WorkQueueStealing<num_threads, ArgTypes...>, num_threads, WorkQueueTraitsStealing<num_threads && num_threads != work_queue_dynamic_threads ? num_threads : 1>, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    using BaseType::WorkQueueBase;
+
+private:
+    void on_thread_start(unsigned int thread_index)
+    {
+        BaseType::queue.set_owner(thread_index);
+    }
+
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        BaseType::conditional_variable.wait(lock);
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUESTEALING_H
@@ -0,0 +1,162 @@
+#ifndef JWUTIL_WORKQUEUETELEMETRY_H
+#define JWUTIL_WORKQUEUETELEMETRY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "workqueuebase.h"
+#include "concurrenthistogram.h"
+
+namespace jw_util
+{
+
+// A queued task plus the time it was pushed
+
+template <typename TupleType>
+struct WorkQueueStampedTask
+{
+    WorkQueueStampedTask() {}
+
+    template <typename... ArgTypes, typename = typename std::enable_if<std::is_constructible<TupleType, ArgTypes &&...>::value>::type>
+    WorkQueueStampedTask(ArgTypes &&... init_args)
+        : args(std::forward<ArgTypes>(init_args)...)
+        , enqueue_time(std::chrono::steady_clock::now())
+    {}
+
+    TupleType args;
+    std::chrono::steady_clock::time_point enqueue_time;
+};
+
+// Telemetry that records how long each task waited in the queue and how long it took to run (both in nanoseconds),
+// the current and maximum queue depth, and how busy each worker thread has been.
+// Everything is updated with relaxed atomics, so it can be read from any thread while the queue is running.
+
+class WorkQueueTelemetryHistogram
+{
+public:
+    static constexpr bool enabled = true;
+    static constexpr unsigned int max_threads = 64;
+
+    template <typename TupleType>
+    using Task = WorkQueueStampedTask<TupleType>;
+
+    typedef ConcurrentHistogram<> HistogramType;
+
+    WorkQueueTelemetryHistogram()
+        : start_time(std::chrono::steady_clock::now())
+    {}
+
+    void on_push(unsigned int count)
+    {
+        std::uint64_t new_depth = depth.fetch_add(count, std::memory_order_relaxed) + count;
+        std::uint64_t prev_max = max_depth.load(std::memory_order_relaxed);
+        while (new_depth > prev_max && !max_depth.compare_exchange_weak(prev_max, new_depth, std::memory_order_relaxed)) {}
+    }
+
+    void on_pop()
+    {
+        depth.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void on_dispatch(unsigned int thread_index, std::chrono::steady_clock::duration wait_time, std::chrono::steady_clock::duration service_time)
+    {
+        std::uint64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wait_time).count();
+        std::uint64_t service_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(service_time).count();
+
+        wait_histogram.record(wait_ns);
+        service_histogram.record(service_ns);
+
+        // Threads past max_threads share slots, which only blurs the per-thread split
+        ThreadCounters &counters = thread_counters[thread_index % max_threads];
+        counters.busy_ns.fetch_add(service_ns, std::memory_order_relaxed);
+        counters.tasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const HistogramType &get_wait_histogram() const {return wait_histogram;}
+    const HistogramType &get_service_histogram() const {return service_histogram;}
+
+    std::uint64_t get_depth() const {return depth.load(std::memory_order_relaxed);}
+    std::uint64_t get_max_depth() const {return max_depth.load(std::memory_order_relaxed);}
+
+    std::uint64_t get_thread_tasks(unsigned int thread_index) const
+    {
+        return thread_counters[thread_index % max_threads].tasks.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t get_thread_busy_ns(unsigned int thread_index) const
+    {
+        return thread_counters[thread_index % max_threads].busy_ns.load(std::memory_order_relaxed);
+    }
+
+    // Fraction of the time since construction (or the last reset) that the thread spent running tasks
+    double get_thread_utilization(unsigned int thread_index) const
+    {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_time;
+        std::uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (!elapsed_ns) {return 0.0;}
+        return static_cast<double>(get_thread_busy_ns(thread_index)) / elapsed_ns;
+    }
+
+    // Clears everything but the current depth. Not synchronized with the workers, so only call it while nothing else is reading the telemetry.
+    void reset()
+    {
+        wait_histogram.reset();
+        service_histogram.reset();
+        max_depth.store(depth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        for (ThreadCounters &counters : thread_counters)
+        {
+            counters.busy_ns.store(0, std::memory_order_relaxed);
+            counters.tasks.store(0, std::memory_order_relaxed);
+        }
+
+        start_time = std::chrono::steady_clock::now();
+    }
+
+private:
+    struct alignas(64) ThreadCounters
+    {
+        std::atomic<std::uint64_t> busy_ns {0};
+        std::atomic<std::uint64_t> tasks {0};
+    };
+
+    HistogramType wait_histogram;
+    HistogramType service_histogram;
+
+    alignas(64) std::atomic<std::uint64_t> depth {0};
+    std::atomic<std::uint64_t> max_depth {0};
+
+    ThreadCounters thread_counters[max_threads];
+
+    std::chrono::steady_clock::time_point start_time;
+};
+
+struct WorkQueueTraitsTelemetry : public WorkQueueTraits
+{
+    typedef WorkQueueTelemetryHistogram Telemetry;
+};
+
+// A WorkQueue that records telemetry, read it with get_telemetry()
+
+template <unsigned int num_threads, typename... ArgTypes>
+class WorkQueueInstrumented : public WorkQueueBase<WorkQueueInstrumented<num_threads, ArgTypes...>, num_threads, WorkQueueTraitsTelemetry, ArgTypes...>
+{
+    typedef WorkQueueBase<WorkQueueInstrumented<num_threads, ArgTypes...>, num_threads, WorkQueueTraitsTelemetry, ArgTypes...> BaseType;
+    friend BaseType;
+
+public:
+    using BaseType::WorkQueueBase;
+
+private:
+    void wait(std::unique_lock<std::mutex> &lock)
+    {
+        BaseType::conditional_variable.wait(lock);
+    }
+};
+
+}
+
+#endif // JWUTIL_WORKQUEUETELEMETRY_H